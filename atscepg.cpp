@@ -17,12 +17,29 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <getopt.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
 #include <vdr/plugin.h>
 #include <vdr/status.h>
 
 #include "devices.h"
 #include "config.h"
 #include "setupMenu.h"
+#include "stats.h"
+#include "vdrInterface.h"
+#include "services.h"
+#include "psipCache.h"
+#include "guideStore.h"
+#include "guideGrid.h"
+#include "guideExport.h"
+#include "xmltvExport.h"
+#include "channelUpdater.h"
+#include "sectionPool.h"
+#include "harvester.h"
+#include "numbering.h"
 
 
 #if VDRVERSNUM < 10714
@@ -37,6 +54,12 @@ static const char* VERSION        = "0.3.0-hg";
 static const char* DESCRIPTION    = "Adds event info for ATSC broadcasts";
 static const char* MAINMENUENTRY  =  NULL; 
 
+#define HOUSEKEEPING_DELAY 60
+#define MAX_SEARCH_RESULTS 100
+#define DEFAULT_GRID_SPAN  30 // Minutes
+#define INDEX_CHUNK        64 // Texts per lock of the guide store
+#define INDEX_TIME         50 // ms per housekeeping
+
 
 //////////////////////////////////////////////////////////////////////////////
 
@@ -44,7 +67,7 @@ static const char* MAINMENUENTRY  =  NULL;
 class cPluginAtscepg : public cPlugin
 {
 private:
-
+  time_t lastHousekeeping;
 
 public:
   cPluginAtscepg(void);
@@ -77,6 +100,7 @@ cPluginAtscepg::cPluginAtscepg(void)
   // Initialize any member variables here.
   // DON'T DO ANYTHING ELSE THAT MAY HAVE SIDE EFFECTS, REQUIRE GLOBAL
   // VDR OBJECTS TO EXIST OR PRODUCE ANY OUTPUT!
+  lastHousekeeping = 0;
 }
 
 
@@ -93,7 +117,13 @@ cPluginAtscepg::~cPluginAtscepg()
 const char *cPluginAtscepg::CommandLineHelp(void)
 {
   // Return a string that describes all known command line options.
-  return NULL;
+  return "  -s FILE,  --shared-guide=FILE  publish a snapshot of the guide to FILE for\n"
+         "                                 other programs, e.g. /dev/shm/atscepg.guide\n"
+         "  -x FILE,  --xmltv=FILE         export the guide as XMLTV to FILE after each\n"
+         "                                 acquisition\n"
+         "  -d NAME,  --devices=NAME       also use the devices offered by plugin NAME\n"
+         "                                 (service GetDevices-v1.0), e.g. a device\n"
+         "                                 replaying a recorded transport stream\n";
 }
 
 
@@ -102,6 +132,24 @@ const char *cPluginAtscepg::CommandLineHelp(void)
 bool cPluginAtscepg::ProcessArgs(int argc, char *argv[])
 {
   // Implement command line argument processing here if applicable.
+  static struct option long_options[] = {
+    { "shared-guide", required_argument, NULL, 's' },
+    { "xmltv",        required_argument, NULL, 'x' },
+    { "devices",      required_argument, NULL, 'd' },
+    { NULL,           no_argument,       NULL,  0  }
+  };
+  
+  int c;
+  while ((c = getopt_long(argc, argv, "s:x:d:", long_options, NULL)) != -1) 
+  {
+    switch (c) {
+      case 's': GuideExport.SetFileName(optarg); break;
+      case 'x': XmltvExport.SetFileName(optarg); break;
+      case 'd': AtscDevices.AddDevicePlugin(optarg); break;
+      default:  return false;
+    }
+  }
+  
   return true;
 }
 
@@ -121,7 +169,20 @@ bool cPluginAtscepg::Start(void)
 {
   // Start any background activities the plugin shall perform.
   AtscDevices.Initialize();
+  ChannelNumbering.SetDirectory(ConfigDirectory("atscepg"));
+  ChannelNumbering.Reload();
+  
+  // Pre-populate the schedules, the filters then only refresh stale tables
+  if (PsipCache.Load(AddDirectory(ConfigDirectory("atscepg"), "psip.cache")))
+    PsipCache.Populate();
+  GuideGrid.Update();
+  GuideExport.Update();
+  XmltvExport.Open(AddDirectory(ConfigDirectory("atscepg"), "xmltv"));
+  SectionPool.Start(config.sectionWorkers);
+    
   AtscDevices.StartFilters();
+  Harvester.Start();
+  ChannelUpdater.Start();
   return true;
 }
 
@@ -131,7 +192,14 @@ bool cPluginAtscepg::Start(void)
 void cPluginAtscepg::Stop(void)
 {
   // Stop any background activities the plugin shall perform.
+  Harvester.Stop();
   AtscDevices.StopFilters();
+  ChannelUpdater.Stop();
+  SectionPool.Stop();
+  ChannelNumbering.Close();
+  PsipCache.Close();
+  GuideExport.Close();
+  XmltvExport.Close();
 }
 
 
@@ -140,6 +208,27 @@ void cPluginAtscepg::Stop(void)
 void cPluginAtscepg::Housekeeping(void)
 {
   // Perform any cleanup or other regular tasks.
+  
+  // Acquisitions only mark the grid, rebuilding it would hold up their 
+  // section handler
+  if (GuideGrid.Dirty())
+    GuideGrid.Update();
+    
+  // New descriptions are decoded for the search index a chunk at a time
+  cTimeMs timer;
+  while (GuideStore.IndexTexts(INDEX_CHUNK) && timer.Elapsed() < INDEX_TIME)
+    ;
+    
+  time_t now = time(NULL);
+  if (now - lastHousekeeping < HOUSEKEEPING_DELAY)
+    return;
+  lastHousekeeping = now;
+  
+  VDRInterface::PublishDescriptions();
+  VDRInterface::EnforceBudget();
+  PsipCache.Compact();
+  GuideGrid.Update();
+  GuideExport.Update();
 }
 
 
@@ -193,6 +282,54 @@ bool cPluginAtscepg::SetupParse(const char *Name, const char *Value)
 bool cPluginAtscepg::Service(const char *Id, void *Data)
 {
   // Handle custom service requests from other plugins
+  if (strcmp(Id, ATSCEPG_DESCRIPTION_SERVICE) == 0) 
+  {
+    if (Data) {
+      AtscEpg_Description_v1_0* d = (AtscEpg_Description_v1_0*) Data;
+      if (!VDRInterface::GetDescription(d->channelID, d->eventID, d->description))
+        d->description = NULL;
+    }
+    return true;
+  }
+  
+  if (strcmp(Id, ATSCEPG_SEARCH_SERVICE) == 0) 
+  {
+    if (Data) {
+      AtscEpg_Search_v1_0* s = (AtscEpg_Search_v1_0*) Data;
+      std::vector<cGuideStore::SearchResult> results;
+      s->numResults = GuideStore.Search(s->query, std::max(s->maxResults, 0), results);
+      for (int i=0; i<s->numResults; i++) {
+        s->results[i].channelID = results[i].channelID;
+        s->results[i].eventID = results[i].eventId;
+        s->results[i].startTime = results[i].startTime;
+        s->results[i].duration = results[i].duration;
+      }
+    }
+    return true;
+  }
+  
+  if (strcmp(Id, ATSCEPG_GRID_SERVICE) == 0) 
+  {
+    if (Data) {
+      AtscEpg_Grid_v1_0* g = (AtscEpg_Grid_v1_0*) Data;
+      g->numEntries = 0;
+      cGridSnapshot* grid = GuideGrid.Get();
+      if (grid) {
+        std::vector<const cGridSnapshot::Event*> slice;
+        g->numEntries = grid->Slice(g->from, g->to, slice);
+        for (int i=0; i<g->numEntries && i<g->maxEntries; i++) {
+          g->entries[i].channelID = grid->Channels()[slice[i]->channel].channelID;
+          g->entries[i].eventID = slice[i]->eventId;
+          g->entries[i].startTime = slice[i]->startTime;
+          g->entries[i].duration = slice[i]->duration;
+          g->entries[i].title = grid->Title(*slice[i]).c_str();
+        }
+        GuideGrid.Put(grid);
+      }
+    }
+    return true;
+  }
+  
   return false;
 }
 
@@ -202,7 +339,22 @@ bool cPluginAtscepg::Service(const char *Id, void *Data)
 const char **cPluginAtscepg::SVDRPHelpPages(void)
 {
   // Return help text for SVDRP commands this plugin implements
-  return NULL;
+  static const char* HelpPages[] = {
+    "STAT\n"
+    "    Print acquisition and EPG memory statistics.",
+    "SRCH <query>\n"
+    "    Search event titles and descriptions. All words must match,\n"
+    "    word* matches a prefix and \"two words\" a phrase.",
+    "GRID [ <time> [ <minutes> ] ]\n"
+    "    List the events of all channels overlapping the given period.\n"
+    "    The time is hh:mm today or seconds since the epoch, default\n"
+    "    now. The period lasts 30 minutes unless given.",
+    "XMLT [ <file> ]\n"
+    "    Export the guide as XMLTV to the given file, or to the file set\n"
+    "    with --xmltv.",
+    NULL
+  };
+  return HelpPages;
 }
 
 
@@ -211,6 +363,108 @@ const char **cPluginAtscepg::SVDRPHelpPages(void)
 cString cPluginAtscepg::SVDRPCommand(const char *Command, const char *Option, int &ReplyCode)
 {
   // Process SVDRP commands this plugin implements
+  if (strcasecmp(Command, "STAT") == 0)
+    return Stats.ToText();
+    
+  if (strcasecmp(Command, "SRCH") == 0) 
+  {
+    std::vector<cGuideStore::SearchResult> results;
+    if (GuideStore.Search(Option, MAX_SEARCH_RESULTS, results) < 0) {
+      ReplyCode = 501;
+      return "Missing search words";
+    }
+    if (results.empty()) {
+      ReplyCode = 550;
+      return "No matching events";
+    }
+    
+    std::string text;
+    for (unsigned int i=0; i<results.size(); i++)
+    {
+      const cGuideStore::SearchResult& r = results[i];
+      char start[32];
+      struct tm tm_r;
+      strftime(start, sizeof(start), "%Y-%m-%d %H:%M", localtime_r(&r.startTime, &tm_r));
+      text += *cString::sprintf("%s %u %s %3d %s", *r.channelID.ToString(), r.eventId, start, r.duration / 60, r.title.c_str());
+      if (i < results.size()-1)
+        text += "\n";
+    }
+    return text.c_str();
+  }
+  
+  if (strcasecmp(Command, "GRID") == 0) 
+  {
+    time_t from = time(NULL);
+    int minutes = DEFAULT_GRID_SPAN;
+    int hh, mm;
+    char* end;
+    char timeText[32] = "";
+    if (Option && *Option && sscanf(Option, "%31s %d", timeText, &minutes) < 1) {
+      ReplyCode = 501;
+      return "Invalid time";
+    }
+    if (*timeText) {
+      if (sscanf(timeText, "%d:%d", &hh, &mm) == 2) {
+        struct tm tm_r;
+        localtime_r(&from, &tm_r);
+        tm_r.tm_hour = hh;
+        tm_r.tm_min = mm;
+        tm_r.tm_sec = 0;
+        tm_r.tm_isdst = -1;
+        from = mktime(&tm_r);
+      }
+      else if ((from = strtol(timeText, &end, 10)) <= 0 || *end) {
+        ReplyCode = 501;
+        return "Invalid time";
+      }
+    }
+    if (minutes <= 0) {
+      ReplyCode = 501;
+      return "Invalid period";
+    }
+    
+    cGridSnapshot* grid = GuideGrid.Get();
+    std::vector<const cGridSnapshot::Event*> slice;
+    if (grid)
+      grid->Slice(from, from + minutes * 60, slice);
+    if (slice.empty()) {
+      GuideGrid.Put(grid);
+      ReplyCode = 550;
+      return "No events";
+    }
+    
+    std::string text;
+    for (unsigned int i=0; i<slice.size(); i++)
+    {
+      const cGridSnapshot::Event& e = *slice[i];
+      const cGridSnapshot::Channel& c = grid->Channels()[e.channel];
+      char start[32];
+      struct tm tm_r;
+      strftime(start, sizeof(start), "%Y-%m-%d %H:%M", localtime_r(&e.startTime, &tm_r));
+      text += *cString::sprintf("%s %d.%d %u %s %3d %s", *c.channelID.ToString(), c.majorNumber, c.minorNumber, e.eventId, start, e.duration / 60, grid->Title(e).c_str());
+      if (i < slice.size()-1)
+        text += "\n";
+    }
+    GuideGrid.Put(grid);
+    return text.c_str();
+  }
+  
+  if (strcasecmp(Command, "XMLT") == 0) 
+  {
+    cString fileName = (Option && *Option) ? cString(Option) : XmltvExport.FileName();
+    if (!*fileName) {
+      ReplyCode = 501;
+      return "Missing file name";
+    }
+    
+    int numChannels, numProgrammes;
+    if (!XmltvExport.Export(fileName, numChannels, numProgrammes)) {
+      ReplyCode = 554;
+      return cString::sprintf("Cannot write %s", *fileName);
+    }
+    return cString::sprintf("Wrote %d channel(s) and %d programme(s) to %s", numChannels, numProgrammes, *fileName);
+  }
+    
   return NULL;
 }
 
@@ -0,0 +1,204 @@
+/*
+ * Copyright (C) 2006-2010 Alex Lasnier <alex@fepg.org>
+ *
+ * This file is part of ATSC EPG
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <vdr/sources.h>
+
+#include "channelUpdater.h"
+#include "tools.h"
+#include "numbering.h"
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+#define CHANNELS_LOCK_TIMEOUT 100  // ms
+#define RETRY_DELAY           5000 // ms, while the channels are locked
+
+cChannelUpdater ChannelUpdater;
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+cChannelUpdater::cChannelUpdater(void) : cThread("ATSC channel updater", true)
+{
+}
+
+
+//----------------------------------------------------------------------------
+
+cChannelUpdater::~cChannelUpdater()
+{
+  Stop();
+  for (std::list<Pending>::iterator i = pending.begin(); i != pending.end(); i++)
+    delete i->transponder;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cChannelUpdater::Stop(void)
+{
+  Cancel(-1);
+  wait.Signal();
+  Cancel(3);
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cChannelUpdater::IsCurrent(uint16_t tsid, uint8_t version)
+{
+  cMutexLock lock(&mutex);
+  return applied.find(((uint32_t) tsid << 8) | version) != applied.end();
+}
+
+
+//----------------------------------------------------------------------------
+
+// Called on the section handler thread, only copies the section
+void cChannelUpdater::Queue(const cChannel* transponder, const uint8_t* data, int length)
+{
+  cMutexLock lock(&mutex);
+  if (!applied.insert(((uint32_t) VCTChannelMap::ExtractTID(data) << 8) | PSIPTable::ExtractVersion(data)).second)
+    return;
+    
+  Pending p;
+  p.transponder = new cChannel(*transponder);
+  pending.push_back(p);
+  pending.back().section.assign(data, data + length);
+  wait.Signal();
+}
+
+
+//----------------------------------------------------------------------------
+
+void cChannelUpdater::Action(void)
+{
+  while (Running())
+  {
+    bool retry = false;
+    
+    while (Running())
+    {
+      Pending p;
+      {
+        cMutexLock lock(&mutex);
+        if (pending.empty())
+          break;
+        p = pending.front();
+      }
+      
+      VCT vct(&p.section[0], p.section.size());
+      if (!vct.CheckCRC()) {
+        cMutexLock lock(&mutex);
+        applied.erase(((uint32_t) VCTChannelMap::ExtractTID(&p.section[0]) << 8) | PSIPTable::ExtractVersion(&p.section[0]));
+      }
+      else if (!Update(p.transponder, vct)) {
+        dprint(L_DBG, "Channel update: channels are locked, trying again later.");
+        retry = true;
+        break;
+      }
+      
+      cMutexLock lock(&mutex);
+      delete pending.front().transponder;
+      pending.pop_front();
+    }
+    
+    wait.Wait(retry ? RETRY_DELAY : 0);
+  }
+}
+
+
+//----------------------------------------------------------------------------
+
+// Returns false if the channels could not be locked
+bool cChannelUpdater::Update(const cChannel* transponder, const VCT& vct)
+{
+  // Find the new channels, then number them without holding the lock since
+  // the number script may take a while. -1 is not added.
+  std::vector<int> numbers(vct.NumberOfChannels(), -1);
+  if (!Channels.Lock(false, CHANNELS_LOCK_TIMEOUT))
+    return false;
+  for (int i=0; i<vct.NumberOfChannels(); i++) 
+  {
+    const AtscChannel* ch = vct.GetChannel(i);
+    if (!Channels.GetByChannelID(tChannelID(cSource::stAtsc, 0, vct.TID(), ch->ProgramNumber()), true) && ch->HasEit() && ch->HasPids())
+      numbers[i] = 0;
+  }
+  Channels.Unlock();
+  
+  for (int i=0; i<vct.NumberOfChannels(); i++) 
+    if (numbers[i] == 0)
+      numbers[i] = ChannelNumbering.Number(vct.GetChannel(i)->MajorNumber(), vct.GetChannel(i)->MinorNumber());
+  
+  if (!Channels.Lock(true, CHANNELS_LOCK_TIMEOUT))
+    return false;
+  
+  int numRenamed = 0, numRepided = 0, numAdded = 0;
+  
+  for (int i=0; i<vct.NumberOfChannels(); i++) 
+  {
+    const AtscChannel* ch = vct.GetChannel(i);
+    cChannel* channel = Channels.GetByChannelID(tChannelID(cSource::stAtsc, 0, vct.TID(), ch->ProgramNumber()), true);
+    
+    if (channel) 
+    {
+      if (strcmp(channel->Name(), ch->LongName()) != 0 || strcmp(channel->ShortName(), ch->ShortName()) != 0) {
+        channel->SetName(ch->LongName(), ch->ShortName(), channel->Provider());
+        numRenamed++;
+      }
+      // Cable VCTs usually leave the PIDs to the PMT
+      if (ch->HasPids() && !ch->SamePids(channel)) {
+        ch->CopyPidsTo(channel);
+        numRepided++;
+      }
+    }
+    else if (numbers[i] >= 0)
+    {
+      // A number past the last channel starts a new group at that number
+      if (numbers[i] > Channels.MaxNumber()) {
+        cChannel* group = new cChannel;
+        if (group->Parse(cString::sprintf(":@%d", numbers[i])))
+          Channels.Add(group);
+        else
+          delete group;
+      }
+      
+      channel = Channels.NewChannel(transponder, ch->LongName(), ch->ShortName(), "", 0, vct.TID(), ch->ProgramNumber());
+      ch->CopyPidsTo(channel);
+      numAdded++;
+      dprint(L_MSG, "Channel update: added %d.%d %s.", ch->MajorNumber(), ch->MinorNumber(), ch->ShortName());
+    }
+  }
+  
+  if (numAdded + numRenamed + numRepided > 0) {
+    Channels.ReNumber();
+    Channels.SetModified();
+  }
+  Channels.Unlock();
+  
+  if (numAdded + numRenamed + numRepided > 0)
+    dprint(L_MSG, "Channel update (TSID %d): %d new, %d renamed, %d with new PIDs.", vct.TID(), numAdded, numRenamed, numRepided);
+    
+  return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2006-2010 Alex Lasnier <alex@fepg.org>
+ *
+ * This file is part of ATSC EPG
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __ATSC_CHANNEL_UPDATER_H
+#define __ATSC_CHANNEL_UPDATER_H
+
+#include <list>
+#include <set>
+#include <vector>
+
+#include <vdr/channels.h>
+#include <vdr/thread.h>
+
+#include "tables.h"
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+// Keeps VDR's channels in line with the VCTs received while acquiring the 
+// guide: PIDs and names of known channels are updated and new subchannels
+// are added, numbered as the scanner does. The filters only queue the VCT
+// sections; numbering and changing the channels is done on this thread, 
+// which retries while VDR holds the channels lock.
+class cChannelUpdater : public cThread
+{
+public:
+  cChannelUpdater(void);
+  virtual ~cChannelUpdater();
+  
+  void Stop(void);
+  bool IsCurrent(uint16_t tsid, uint8_t version); // Applied or queued
+  void Queue(const cChannel* transponder, const uint8_t* data, int length);
+  
+protected:
+  virtual void Action(void);
+  
+private:
+  struct Pending {
+    cChannel* transponder;
+    std::vector<uint8_t> section;
+  };
+  
+  bool Update(const cChannel* transponder, const VCT& vct);
+  
+  std::set<uint32_t> applied; // TSID << 8 | version, including queued ones
+  std::list<Pending> pending;
+  
+  cMutex mutex;
+  cCondWait wait;
+};
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+extern cChannelUpdater ChannelUpdater;
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+#endif //__ATSC_CHANNEL_UPDATER_H
@@ -38,6 +38,14 @@ cATSCConfig config;
 cATSCConfig::cATSCConfig(void)
 {
   //setTime  = 0;
+  useEpgHandlers = false;
+  epgHorizon = 16; // EIT-0 to EIT-127
+  epgBudget = 0;
+  descriptionWindow = 0;
+  updateChannels = false;
+  sectionWorkers = 0;
+  harvest = false;
+  throttle = true;
   logType = L_DEFAULT;
   logConsole = true;
   logFile = false;
@@ -59,7 +67,15 @@ cATSCConfig::~cATSCConfig()
 bool cATSCConfig::SetupParse(const char* Name, const char* Value)
 {
   //if (!strcasecmp(Name, "setTime"))  config.setTime = atoi(Value);
-  if      (!strcasecmp(Name, "logType"))    logType    = atoi(Value);
+  if      (!strcasecmp(Name, "useEpgHandlers")) useEpgHandlers = atoi(Value);
+  else if (!strcasecmp(Name, "epgHorizon"))     epgHorizon     = atoi(Value);
+  else if (!strcasecmp(Name, "epgBudget"))      epgBudget      = atoi(Value);
+  else if (!strcasecmp(Name, "descriptionWindow")) descriptionWindow = atoi(Value);
+  else if (!strcasecmp(Name, "updateChannels")) updateChannels = atoi(Value);
+  else if (!strcasecmp(Name, "sectionWorkers")) sectionWorkers = atoi(Value);
+  else if (!strcasecmp(Name, "harvest")) harvest = atoi(Value);
+  else if (!strcasecmp(Name, "throttle")) throttle = atoi(Value);
+  else if (!strcasecmp(Name, "logType"))    logType    = atoi(Value);
   else if (!strcasecmp(Name, "logConsole")) logConsole = atoi(Value);
   else if (!strcasecmp(Name, "logFile"))    logFile    = atoi(Value);
   else if (!strcasecmp(Name, "logSyslog"))  logSyslog  = atoi(Value);
@@ -33,6 +33,14 @@ public:
   bool SetupParse(const char* Name, const char* Value);
   
   //int setTime;
+  int useEpgHandlers;
+  int epgHorizon; // Days
+  int epgBudget;  // MB, 0 = unlimited
+  int descriptionWindow; // Hours, 0 = decode immediately
+  int updateChannels; // Apply VCT changes to VDR's channels
+  int sectionWorkers; // Threads parsing EITs and ETTs, 0 = none
+  int harvest; // Acquire other transponders on idle devices
+  int throttle; // Acquire less at once while a device is recording
   int logType;
   int logConsole;
   int logFile;
@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2006-2010 Alex Lasnier <alex@fepg.org>
+ *
+ * This file is part of ATSC EPG
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "descriptionStore.h"
+#include "descriptors.h"
+#include "stats.h"
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+#define LRU_SIZE 64
+
+cDescriptionStore DescriptionStore;
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+cDescriptionStore::cDescriptionStore(void)
+{
+  rawBytes = 0;
+}
+
+
+//----------------------------------------------------------------------------
+
+cDescriptionStore::~cDescriptionStore()
+{
+
+}
+
+
+//----------------------------------------------------------------------------
+
+uint64_t cDescriptionStore::Key(const tChannelID& channelID, u16 eventId)
+{
+  return ((uint64_t) (channelID.Tid() & 0xFFFF) << 32) | ((uint64_t) (channelID.Sid() & 0xFFFF) << 16) | eventId;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cDescriptionStore::Put(const tChannelID& channelID, u16 eventId, time_t startTime, const u8* mss, int length)
+{
+  if (!MultipleStringStructure::IsValid(mss, length))
+    return;
+    
+  cMutexLock lock(&mutex);
+  
+  uint64_t key = Key(channelID, eventId);
+  EntryMap::iterator itr = entries.find(key);
+  if (itr != entries.end())
+    Erase(itr);
+  
+  Entry& e = entries[key];
+  e.channelID = channelID;
+  e.startTime = startTime;
+  e.raw.assign((const char*) mss, length);
+  
+  byStartTime.insert(std::make_pair(startTime, key));
+  rawBytes += length;
+  
+  Stats.Set(S_DESCRIPTIONS_STORED, entries.size());
+  Stats.Set(S_DESCRIPTIONS_RAW_BYTES, rawBytes);
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cDescriptionStore::Get(const tChannelID& channelID, u16 eventId, std::string& description)
+{
+  cMutexLock lock(&mutex);
+  
+  uint64_t key = Key(channelID, eventId);
+  
+  std::map<uint64_t, LruList::iterator>::iterator c = lruIndex.find(key);
+  if (c != lruIndex.end()) {
+    lru.splice(lru.begin(), lru, c->second); // Most recently used
+    description = c->second->second;
+    return true;
+  }
+  
+  EntryMap::const_iterator itr = entries.find(key);
+  if (itr == entries.end() || !Decode(itr->second, description))
+    return false;
+    
+  Cache(key, description);
+  return true;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cDescriptionStore::Del(const tChannelID& channelID, u16 eventId)
+{
+  cMutexLock lock(&mutex);
+  
+  EntryMap::iterator itr = entries.find(Key(channelID, eventId));
+  if (itr != entries.end())
+    Erase(itr);
+}
+
+
+//----------------------------------------------------------------------------
+
+void cDescriptionStore::TakeDue(time_t time, std::list<Description>& due)
+{
+  cMutexLock lock(&mutex);
+  
+  while (!byStartTime.empty() && byStartTime.begin()->first < time)
+  {
+    EntryMap::iterator itr = entries.find(byStartTime.begin()->second);
+    if (itr == entries.end()) { // Should not happen
+      byStartTime.erase(byStartTime.begin());
+      continue;
+    }
+    
+    Description d;
+    d.channelID = itr->second.channelID;
+    d.eventId = itr->first & 0xFFFF;
+    if (Decode(itr->second, d.text))
+      due.push_back(d);
+    Erase(itr);
+  }
+}
+
+
+//----------------------------------------------------------------------------
+
+int cDescriptionStore::Count(void)
+{
+  cMutexLock lock(&mutex);
+  return entries.size();
+}
+
+
+//----------------------------------------------------------------------------
+
+long long cDescriptionStore::RawBytes(void)
+{
+  cMutexLock lock(&mutex);
+  return rawBytes;
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cDescriptionStore::Decode(const Entry& entry, std::string& description)
+{
+  description = MultipleStringStructure::FirstString((const u8*) entry.raw.data(), entry.raw.size());
+  if (description.empty())
+    return false;
+  
+  Stats.Add(S_DESCRIPTIONS_DECODED);
+  return true;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cDescriptionStore::Cache(uint64_t key, const std::string& description)
+{
+  lru.push_front(std::make_pair(key, description));
+  lruIndex[key] = lru.begin();
+  
+  if (lru.size() > LRU_SIZE) {
+    lruIndex.erase(lru.back().first);
+    lru.pop_back();
+  }
+}
+
+
+//----------------------------------------------------------------------------
+
+void cDescriptionStore::Uncache(uint64_t key)
+{
+  std::map<uint64_t, LruList::iterator>::iterator c = lruIndex.find(key);
+  if (c != lruIndex.end()) {
+    lru.erase(c->second);
+    lruIndex.erase(c);
+  }
+}
+
+
+//----------------------------------------------------------------------------
+
+void cDescriptionStore::Erase(EntryMap::iterator itr)
+{
+  std::pair<std::multimap<time_t, uint64_t>::iterator, std::multimap<time_t, uint64_t>::iterator> range;
+  range = byStartTime.equal_range(itr->second.startTime);
+  for (std::multimap<time_t, uint64_t>::iterator i = range.first; i != range.second; i++)
+    if (i->second == itr->first) {
+      byStartTime.erase(i);
+      break;
+    }
+    
+  Uncache(itr->first);
+  rawBytes -= itr->second.raw.size();
+  entries.erase(itr);
+  
+  Stats.Set(S_DESCRIPTIONS_STORED, entries.size());
+  Stats.Set(S_DESCRIPTIONS_RAW_BYTES, rawBytes);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
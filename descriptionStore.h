@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2006-2010 Alex Lasnier <alex@fepg.org>
+ *
+ * This file is part of ATSC EPG
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __ATSC_DESCRIPTION_STORE_H
+#define __ATSC_DESCRIPTION_STORE_H
+
+#include <map>
+#include <list>
+#include <string>
+
+#include <vdr/channels.h>
+#include <vdr/thread.h>
+
+#include "tools.h"
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+// Keeps ETT texts in their broadcast form (multiple string structures, 
+// usually Huffman compressed) and only decodes them when asked for. The 
+// key is the ETM_id with the source id replaced by the program number and 
+// the TSID added, so it is unique across transport streams and can be 
+// built from a VDR channel and event id.
+class cDescriptionStore
+{
+public:
+  cDescriptionStore(void);
+ ~cDescriptionStore();
+ 
+  struct Description {
+    tChannelID channelID;
+    u16 eventId;
+    std::string text;
+  };
+  
+  static uint64_t Key(const tChannelID& channelID, u16 eventId);
+ 
+  void Put(const tChannelID& channelID, u16 eventId, time_t startTime, const u8* mss, int length);
+  bool Get(const tChannelID& channelID, u16 eventId, std::string& description);
+  void Del(const tChannelID& channelID, u16 eventId);
+  
+  // Removes and decodes the descriptions of all events starting before 'time'
+  void TakeDue(time_t time, std::list<Description>& due);
+  
+  int Count(void);
+  long long RawBytes(void);
+  
+private:
+  struct Entry {
+    tChannelID channelID;
+    time_t startTime;
+    std::string raw;
+  };
+  
+  typedef std::map<uint64_t, Entry> EntryMap;
+  typedef std::list<std::pair<uint64_t, std::string> > LruList;
+  
+  bool Decode(const Entry& entry, std::string& description);
+  void Cache(uint64_t key, const std::string& description);
+  void Uncache(uint64_t key);
+  void Erase(EntryMap::iterator itr);
+
+  EntryMap entries;
+  std::multimap<time_t, uint64_t> byStartTime;
+  long long rawBytes;
+  
+  LruList lru;
+  std::map<uint64_t, LruList::iterator> lruIndex;
+  
+  cMutex mutex;
+};
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+extern cDescriptionStore DescriptionStore;
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+#endif //__ATSC_DESCRIPTION_STORE_H
@@ -106,6 +106,46 @@ std::string MultipleStringStructure::GetString(u32 i) const
 } 
 
 
+//----------------------------------------------------------------------------
+
+// Empty if there is no string or the structure does not fit in length
+std::string MultipleStringStructure::FirstString(const u8* data, int length)
+{
+  if (!IsValid(data, length) || data[0] == 0)
+    return "";
+    
+  //TODO: Other languages...
+  return MultipleStringStructure(data).GetString(0);
+}
+
+
+//----------------------------------------------------------------------------
+
+bool MultipleStringStructure::IsValid(const u8* data, int length)
+{
+  if (!data || length < 1)
+    return false;
+    
+  const u8* end = data + length;
+  const u8* d = data + 1;
+  for (u8 i=0; i<data[0]; i++)
+  {
+    if (d + 4 > end)
+      return false;
+    u8 number_segments = d[3];
+    d += 4;
+    for (u8 j=0; j<number_segments; j++) 
+    {
+      if (d + 3 > end || d + 3 + d[2] > end)
+        return false;
+      d += 3 + d[2];
+    }
+  }
+  
+  return true;
+}
+
+
 //////////////////////////////////////////////////////////////////////////////
 
 
@@ -201,6 +241,89 @@ DescriptorLoop::DescriptorLoop(const u8* data, u16 length)
 }
 
 
+//////////////////////////////////////////////////////////////////////////////
+
+
+void ParseEventDescriptors(const u8* data, u16 length, EventAttributes& attributes)
+{
+  const u8* end = data + length;
+  
+  for (const u8* dc = data; dc + 2 <= end && dc + 2 + dc[1] <= end; dc += dc[1] + 2)
+  {
+    const u8* d = dc + 2;
+    u8 len = dc[1];
+    
+    switch (dc[0])
+    {
+      case GenreDescriptorTag:
+      {
+        if (len < 1) break;
+        u8 count = d[0] & 0x1F;
+        for (u8 i=0; i<count && i+1<len && attributes.numGenres<4; i++)
+          if (d[1+i])
+            attributes.genre[attributes.numGenres++] = d[1+i];
+      }
+      break;
+      
+      case ContentAdvisoryDescriptorTag:
+      {
+        if (len < 1) break;
+        u8 regions = d[0] & 0x3F;
+        const u8* r = d + 1;
+        for (u8 i=0; i<regions && r + 2 <= d + len; i++)
+        {
+          u8 region = r[0];
+          u8 dimensions = r[1];
+          if (r + 3 + 2*dimensions > d + len) 
+            break;
+            
+          // Keep the first region, but prefer region 1 (US)
+          if (!attributes.ratingRegion || (region == 1 && attributes.ratingRegion != 1))
+          {
+            attributes.ratingRegion = region;
+            attributes.ratings = 0;
+            for (u8 j=0; j<dimensions; j++)
+            {
+              u8 dimension = r[2 + 2*j];
+              u8 value     = r[3 + 2*j] & 0x0F;
+              if (dimension < 8)
+                attributes.ratings |= value << (4*dimension);
+            }
+          }
+          r += 2 + 2*dimensions + 1 + r[2 + 2*dimensions];
+        }
+      }
+      break;
+      
+      case CaptionServiceDescriptorTag:
+      {
+        if (len < 1) break;
+        attributes.captions = true;
+        u8 services = d[0] & 0x1F;
+        for (u8 i=0; i<services && 1 + 6*(i+1) <= len; i++)
+        {
+          const u8* c = d + 1 + 6*i;
+          attributes.digitalCC  |= (c[3] & 0x80) >> 7;
+          attributes.easyReader |= (c[4] & 0x80) >> 7;
+          attributes.wideAspect |= (c[4] & 0x40) >> 6;
+        }
+      }
+      break;
+      
+      case AC3AudioDescriptorTag:
+        if (len < 3) break;
+        attributes.ac3 = true;
+        attributes.surround = (d[1] & 0x03) == 0x02;
+        attributes.audioChannels = (d[2] & 0x1E) >> 1;
+      break;
+      
+      default:
+      break;
+    }
+  }
+}
+
+
 //////////////////////////////////////////////////////////////////////////////
 
 #if 0
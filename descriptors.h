@@ -21,6 +21,7 @@
 #define __ATSCDESCRIPTORS_H
 
 #include <string>
+#include <vector>
 
 #include <vdr/tools.h>
 
@@ -62,6 +63,9 @@ public:
   std::string GetString(u32 i) const;
   virtual void Print(void) const;
   
+  static bool IsValid(const u8* data, int length); // Strings and segments within length
+  static std::string FirstString(const u8* data, int length);
+  
 protected:
   u8 number_strings;
   std::vector<std::string> strings;
@@ -209,6 +213,14 @@ private:
 //////////////////////////////////////////////////////////////////////////////
 
 
+// Decodes the descriptors of an EIT event in a single pass, without 
+// creating Descriptor objects.
+void ParseEventDescriptors(const u8* data, u16 length, EventAttributes& attributes);
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
 // Unimplemented descriptors
 /*
 class TimeShiftedServiceDescriptor : public Descriptor
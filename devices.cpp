@@ -75,25 +75,15 @@ void cAtscDevices::Initialize(void)
       if (frontendInfo.type == FE_ATSC) 
       {
         dprint(L_MSG, "Found ATSC device (#%d) %s", i, frontendInfo.name);
-        devices[numDevices] = new DeviceInfo(numDevices+1, cDevice::GetDevice(i), frontendInfo.name);
+        devices[numDevices] = new DeviceInfo(numDevices+1, cDevice::GetDevice(i), frontendInfo.name, i);
         numDevices++;
       }
     close(fe);
   }
   
-  if (cPlugin* plugin = cPluginManager::GetPlugin("hdhomerun"))
-  {
-    dprint(L_MSG, "Looking for HDHomeRun devices.");
-    HDHomeRunDeviceList_v1_0 dl;
-    dl.numDevices = 0;
-    plugin->Service("GetDevices-v1.0", &dl);
-    for (int i=0; i<dl.numDevices && numDevices < MAXDEVICES; i++)
-    {
-      dprint(L_MSG, "Found HDHomeRun device %s.", dl.names[i]);
-      devices[numDevices] = new DeviceInfo(numDevices+1, dl.devices[i], dl.names[i]);
-      numDevices++;
-    } 
-  }
+  AddPluginDevices("hdhomerun");
+  for (int i=0; i<devicePlugins.Size(); i++)
+    AddPluginDevices(devicePlugins[i]);
   
   if (numDevices)
     dprint(L_MSG, "Found %d ATSC device%s", numDevices, numDevices==1?"":"s");
@@ -102,6 +92,37 @@ void cAtscDevices::Initialize(void)
 }
 
 
+//----------------------------------------------------------------------------
+
+void cAtscDevices::AddDevicePlugin(const char* Name)
+{
+  devicePlugins.Append(strdup(Name));
+}
+
+
+//----------------------------------------------------------------------------
+
+// Devices provided by other plugins, such as HDHomeRun network tuners or a 
+// device replaying a recorded transport stream
+void cAtscDevices::AddPluginDevices(const char* Name)
+{
+  cPlugin* plugin = cPluginManager::GetPlugin(Name);
+  if (!plugin)
+    return;
+    
+  dprint(L_MSG, "Looking for %s devices.", Name);
+  HDHomeRunDeviceList_v1_0 dl;
+  dl.numDevices = 0;
+  plugin->Service("GetDevices-v1.0", &dl);
+  for (int i=0; i<dl.numDevices && numDevices < MAXDEVICES; i++)
+  {
+    dprint(L_MSG, "Found %s device %s.", Name, dl.names[i]);
+    devices[numDevices] = new DeviceInfo(numDevices+1, dl.devices[i], dl.names[i]);
+    numDevices++;
+  } 
+}
+
+
 //----------------------------------------------------------------------------
 
 void cAtscDevices::StartFilters(void)
@@ -122,11 +143,12 @@ void cAtscDevices::StopFilters(void)
 
 //----------------------------------------------------------------------------
  
-cAtscDevices::DeviceInfo::DeviceInfo(int numDev, cDevice* dev, const char* nam)
+cAtscDevices::DeviceInfo::DeviceInfo(int numDev, cDevice* dev, const char* nam, int adap)
 {
-  filter = new cATSCFilter(numDev);
+  filter = new cATSCFilter(numDev, dev);
   device = dev;
   name = strdup(nam);
+  adapter = adap;
 }
 
 
@@ -33,25 +33,31 @@ class cAtscDevices
 public:
   cAtscDevices(void);
  ~cAtscDevices();
+  void AddDevicePlugin(const char* Name);
   void Initialize(void);
   void StartFilters(void);
   void StopFilters(void);
   int NumDevices(void) const { return numDevices; }
   cDevice* GetDevice(int i) { return (i>=0 && i<numDevices) ? devices[i]->device : NULL; }
   const char* GetName(int i) { return (i>=0 && i<numDevices) ? devices[i]->name : NULL; }
+  int GetAdapter(int i) { return (i>=0 && i<numDevices) ? devices[i]->adapter : -1; }
 
 private:  
   class DeviceInfo {
   public:
-    DeviceInfo(int numDev, cDevice* dev, const char* nam);
+    DeviceInfo(int numDev, cDevice* dev, const char* nam, int adap = -1);
     ~DeviceInfo();
 
     cATSCFilter* filter;
     cDevice* device;
     char* name;
+    int adapter; // DVB adapter number, -1 for devices of other plugins
   };
+  void AddPluginDevices(const char* Name);
+  
   DeviceInfo* devices[MAXDEVICES];
   int numDevices;
+  cStringList devicePlugins;
 };
 
 
@@ -19,6 +19,7 @@
 
 #include <stdarg.h>
 #include <algorithm>
+#include <set>
 
 #include <vdr/filter.h>
 #include <libsi/section.h>
@@ -28,6 +29,13 @@
 #include "filterManager.h"
 #include "tables.h"
 #include "tools.h"
+#include "config.h"
+#include "stats.h"
+#include "psipCache.h"
+#include "guideGrid.h"
+#include "xmltvExport.h"
+#include "ratingTables.h"
+#include "channelUpdater.h"
 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -42,27 +50,39 @@
 
 #define MGT_SCAN_DELAY 60 
 #define STT_SCAN_DELAY 60 
+#define CHANNELS_LOCK_TIMEOUT 100 // ms
+
+// While throttled
+#define LOAD_CHECK_DELAY       5
+#define THROTTLED_SCAN_DELAY 600
+#define THROTTLED_EIT_PIDS     2 // Open at the same time
+#define THROTTLED_BACKLOG     64 // Sections waiting in the pool
 
 
 ///////////////////////////////////////////////////////////////////////////////
 
 
-cATSCFilter::cATSCFilter(int num)
+cATSCFilter::cATSCFilter(int num, cDevice* Device) : limiter(num)
 {
   fNum = num;
+  device = Device;
   F_LOG(L_DBGV, "Created.");
-  FilterManager.AddFilter(this);
+  memberId = FilterManager.AddFilter(this);
   
   newMGTVersion = 0;
   gotMGT = false;
   gotVCT = false;
-  gotRRT = false;
+  vctConfirmed = false;
+  waiting = false;
+  throttled = false;
+  ettsDeferred = false;
   
   lastScanMGT = 0;
   lastScanSTT = 0;
+  lastLoadCheck = 0;
   
   Set(0x1FFB, 0xC7); // MGT
-  // Set(0x1FFB, 0xCA); // RRT
+  Set(0x1FFB, 0xCA); // RRT
   // Set(0x1FFB, 0xCD); // SST
   // Set(0x1FFB, 0xCE); // DET
   // Set(0x1FFB, 0xCF); // DST
@@ -84,6 +104,7 @@ cATSCFilter::~cATSCFilter()
 void cATSCFilter::SetStatus(bool On)
 { 
   if (!On) {
+    FilterManager.Reset(memberId);
     cFilter::SetStatus(false);
     return;
   }
@@ -91,6 +112,8 @@ void cATSCFilter::SetStatus(bool On)
   if (const cChannel* c = Channel()) {
     if (c->Number())
       F_LOG(L_MSG, "Switched to channel %d (%s)", c->Number(), *(c->GetChannelID().ToString()));
+    else if (FilterManager.IsScanHarvest(Transponder()))
+      F_LOG(L_MSG, "Channel scan: harvesting transponder %d", Transponder());
     else {
       F_LOG(L_DBG, "Channel scan: not activating filter");
 
@@ -109,12 +132,9 @@ void cATSCFilter::SetStatus(bool On)
   prevTransponder = Transponder();
   */
   ResetFilter();
-  FilterManager.Reset(this);
-    
-  if (FilterManager.Set(this, Transponder()))
-    cFilter::SetStatus(true);
-  else
-    F_LOG(L_DBG, "This transponder is being updated by another filter.");
+  FilterManager.Reset(memberId);
+  FilterManager.Set(memberId, Transponder());
+  cFilter::SetStatus(true);
 }
 
 
@@ -124,16 +144,34 @@ void cATSCFilter::ResetFilter(void)
 {
   gotMGT = false;
   gotVCT = false;
-  gotRRT = false;
+  waiting = false;
+  ettsDeferred = false;
 
   newMGTVersion = 0;
   lastScanMGT = 0;
   lastScanSTT = 0;
 
+  sections.Clear();
+  limiter.Clear();
   channelSIDs.clear();
   eitPids.clear();
   ettEIDs.clear();
   ettPids.clear();
+  pendingEitPids.clear();
+  openEitPids.clear();
+  tableVersions.clear();
+  slotEitPids.clear();
+  slotEttPids.clear();
+  claimedSlots.clear();
+  
+  // Start with the channel map seen last time, the VCT only has to confirm it
+  vctConfirmed = false;
+  ChannelMap channelMap;
+  if (FilterManager.GetLastChannelMap(Transponder(), channelMap)) {
+    F_LOG(L_DBG, "Using known channel map (TSID: %d, version: %d)", channelMap.tsid, channelMap.version);
+    SetChannelMap(channelMap);
+    gotVCT = true;
+  }
     
   // Add(0x0000, 0x00); // PAT
   Add(0x1FFB, 0xC8, 0xFE); // VCT-T/C
@@ -144,11 +182,17 @@ void cATSCFilter::ResetFilter(void)
 
 void cATSCFilter::Process(u_short Pid, u_char Tid, const u_char* Data, int length)
 {
+  if (!limiter.Allow(Pid, Tid))
+    return;
+    
   if (length < 15) {
-    F_LOG(L_ERR, "Insufficient data length.");
+    Stats.Add(S_SECTIONS_BAD_LENGTH);
     return;
   }
   
+  CommitSections();
+  CheckLoad();
+  
   switch (Tid)
   {
     case 0x00: // PAT
@@ -163,8 +207,12 @@ void cATSCFilter::Process(u_short Pid, u_char Tid, const u_char* Data, int lengt
     
     case 0xC7: // MGT: Master Guide Table
     {
+      if (waiting) { // Take over slots handed back by other filters
+        ClaimWork();
+        return;
+      }
       time_t now = time(NULL);
-      if (!gotVCT || gotMGT || now - lastScanMGT <= MGT_SCAN_DELAY) return;
+      if (!gotVCT || gotMGT || now - lastScanMGT <= (throttled ? THROTTLED_SCAN_DELAY : MGT_SCAN_DELAY)) return;
       if (ProcessMGT(Data, length)) {
         gotMGT = true;
       }
@@ -174,20 +222,22 @@ void cATSCFilter::Process(u_short Pid, u_char Tid, const u_char* Data, int lengt
       
     case 0xC8: // VCT-T: Terrestrial Virtual Channel Table
     case 0xC9: // VCT-C: Cable Virtual Channel Table
-      if (gotVCT) return;
+      if (vctConfirmed) return;
       F_LOG(L_MSG, "Received VCT-%c.", Tid==0xC8?'T':'C');
       if (ProcessVCT(Data, length)) {
         gotVCT = true;
+        vctConfirmed = true;
         Del(0x1FFB, 0xC8, 0xFE);
       }
     break; 
       
     case 0xCA: // RRT: Rating Region Table
     {
-      if (gotRRT) return;
-      F_LOG(L_DBG, "Received RRT: Not yet implemented.");
+      if (RatingTables.Has(RRT::ExtractRegion(Data), PSIPTable::ExtractVersion(Data))) return;
       RRT rrt(Data, length);
-      gotRRT = true;
+      if (!rrt.CheckCRC()) return;
+      F_LOG(L_MSG, "Received RRT for region %d, version %d.", rrt.Region().region, rrt.Version());
+      RatingTables.Put(rrt.Region());
     }
     break; 
       
@@ -202,7 +252,7 @@ void cATSCFilter::Process(u_short Pid, u_char Tid, const u_char* Data, int lengt
     case 0xCD: // STT: System Time Table
     {
       time_t now = time(NULL);
-      if (now - lastScanSTT <= STT_SCAN_DELAY) return;
+      if (now - lastScanSTT <= (throttled ? THROTTLED_SCAN_DELAY : STT_SCAN_DELAY)) return;
       F_LOG(L_MSG, "Received STT.");
       lastScanSTT = now;
     }
@@ -297,6 +347,25 @@ bool cATSCFilter::ProcessMGT(const uint8_t* data, int length)
   eitPids.clear();  
   ettEIDs.clear();  
   ettPids.clear();
+  pendingEitPids.clear();
+  openEitPids.clear();
+  ettsDeferred = false;
+  tableVersions.clear();
+  slotEitPids.clear();
+  slotEttPids.clear();
+  claimedSlots.clear();
+  
+  // EIT-k and ETT-k are refreshed together, the ETT needs the event ids
+  std::set<uint8_t> staleSlots;
+  int bytes = 0;
+  for (u8 k = 0; k < mgt.NumberOfTables(); k++)
+  {
+    const Table* t = mgt.GetTable(k);
+    if (t->number_bytes == 0 || BeyondHorizon(t->table_type))
+      continue;
+    if ((t->tid == 0xCB || t->tid == 0xCC) && IsStale(t->table_type, t->version))
+      staleSlots.insert(t->table_type & 0x7F);
+  }
       
   for (u8 k = 0; k < mgt.NumberOfTables(); k++)
   {
@@ -304,6 +373,21 @@ bool cATSCFilter::ProcessMGT(const uint8_t* data, int length)
     dprint(L_MGT, "Table ID: 0x%02X, PID: 0x%04X, Bytes: %d", t->tid, t->pid, t->number_bytes);
     if (t->number_bytes == 0)
       continue;
+      
+    if (BeyondHorizon(t->table_type)) {
+      F_LOG(L_MGT, "MGT: Skipping table type 0x%04X (beyond horizon)", t->table_type);
+      Stats.Add(S_TABLES_HORIZON);
+      continue;
+    }
+    
+    if (t->tid == 0xCB || t->tid == 0xCC) 
+    {
+      tableVersions[t->table_type] = t->version;
+      if (t->table_type != 0x0004 && staleSlots.find(t->table_type & 0x7F) == staleSlots.end()) {
+        F_LOG(L_MGT, "MGT: Table type 0x%04X is up to date (%d)", t->table_type, t->version);
+        continue;
+      }
+    }
 
     switch (t->tid)
     {   
@@ -312,24 +396,19 @@ bool cATSCFilter::ProcessMGT(const uint8_t* data, int length)
           F_LOG(L_MGT, "MGT: Found channel ETT PID");
           // Usually provides a short description, not very useful.
         }  
-        else { // Event ETT 
+        else if (t->table_type >= 0x0200 && t->table_type <= 0x027F) { // Event ETT 
           F_LOG(L_MGT, "MGT: Found ETT PID: %d", t->pid);
-          ettPids.push_back(t->pid); // Save these for after we have the EITs
+          slotEttPids[t->table_type & 0x7F] = t->pid; // Save these for after we have the EITs
+          bytes += t->number_bytes;
         }
       break; 
 
       case 0xCB: // EIT
-      {
-        F_LOG(L_MGT, "MGT: Found EIT PID: %d", t->pid);
-        
-        std::list<uint16_t>::const_iterator itr;
-        for(itr = channelSIDs.begin(); itr != channelSIDs.end(); itr++)
-        {
-          u32 v = (((u32) *itr) << 16) | t->pid;
-          eitPids.push_back(v);
-          Add(t->pid, t->tid);
+        if (t->table_type >= 0x0100 && t->table_type <= 0x017F) {
+          F_LOG(L_MGT, "MGT: Found EIT PID: %d", t->pid);
+          slotEitPids[t->table_type & 0x7F] = t->pid;
+          bytes += t->number_bytes;
         }
-      }
       break;
       
       case 0xCA: // RRT
@@ -342,35 +421,272 @@ bool cATSCFilter::ProcessMGT(const uint8_t* data, int length)
     }
   }
   
+  if (slotEitPids.size() == 0 || channelSIDs.size() == 0) {
+    F_LOG(L_MSG, "MGT: All tables are up to date.");
+    AcquisitionComplete();
+    return false;
+  }
+  
+  // Other filters on this transponder may share the work
+  std::vector<uint8_t> slots;
+  for (std::map<uint8_t, uint16_t>::const_iterator i = slotEitPids.begin(); i != slotEitPids.end(); i++)
+    slots.push_back(i->first);
+  FilterManager.BeginAcquisition(Transponder(), newMGTVersion, slots, bytes);
+  
+  ClaimWork();
+  return !claimedSlots.empty() || waiting;
+}
+
+
+//----------------------------------------------------------------------------
+
+// Starts acquiring the next share of the slots of the current MGT. Returns
+// false if there was nothing left to claim.
+bool cATSCFilter::ClaimWork(void)
+{
+  std::vector<uint8_t> slots;
+  int n = FilterManager.Claim(memberId, Transponder(), newMGTVersion, slots);
+  
+  if (n <= 0) 
+  {
+    // Wait while other filters finish their slots or hand them back
+    waiting = n == 0 && !FilterManager.Complete(Transponder(), newMGTVersion);
+    if (!waiting) {
+      F_LOG(L_MSG, "Acquisition finished by other filters.");
+      gotMGT = false;
+    }
+    return false;
+  }
+  
+  F_LOG(L_MSG, "Claimed %d of the EIT/ETT slots.", n);
+  waiting = false;
+  claimedSlots = slots;
+  
+  for (int i=0; i<n; i++)
+  {
+    uint16_t pid = slotEitPids[slots[i]];
+    for (std::list<uint16_t>::const_iterator itr = channelSIDs.begin(); itr != channelSIDs.end(); itr++)
+      eitPids.push_back((((u32) *itr) << 16) | pid);
+    pendingEitPids.push_back(pid);
+    
+    std::map<uint8_t, uint16_t>::const_iterator ett = slotEttPids.find(slots[i]);
+    if (ett != slotEttPids.end())
+      ettPids.push_back(ett->second);
+  }
+  
+  OpenEitFilters();
   return true;
 }
 
 
+//----------------------------------------------------------------------------
+
+// Opens the filters for the claimed EIT PIDs, only a few at a time while 
+// throttled
+void cATSCFilter::OpenEitFilters(void)
+{
+  while (!pendingEitPids.empty() && (!throttled || openEitPids.size() < THROTTLED_EIT_PIDS))
+  {
+    uint16_t pid = pendingEitPids.front();
+    pendingEitPids.pop_front();
+    
+    openEitPids[pid] = channelSIDs.size();
+    for (std::list<uint16_t>::const_iterator itr = channelSIDs.begin(); itr != channelSIDs.end(); itr++)
+      Add(pid, 0xCB);
+  }
+}
+
+
+//----------------------------------------------------------------------------
+
+void cATSCFilter::OpenEttFilters(void)
+{
+  for(std::list<uint16_t>::iterator i = ettPids.begin(); i != ettPids.end(); i++) {
+    Add(*i, 0xCC);
+  } 
+}
+
+
+//----------------------------------------------------------------------------
+
+// Recording an HD channel on a weak box or USB tuner leaves little room for
+// section filtering: while the device is recording, or the section pool is 
+// falling behind, fewer EIT filters are open at once, ETTs wait and the MGT
+// and STT are checked less often.
+void cATSCFilter::CheckLoad(void)
+{
+  time_t now = time(NULL);
+  if (now - lastLoadCheck < LOAD_CHECK_DELAY)
+    return;
+  lastLoadCheck = now;
+  
+  bool load = config.throttle && ((device && device->Receiving(false)) || SectionPool.Backlog() > THROTTLED_BACKLOG);
+  if (load == throttled)
+    return;
+  
+  throttled = load;
+  if (throttled) {
+    F_LOG(L_MSG, "Device busy, throttling acquisition.");
+    Stats.Add(S_THROTTLED);
+    return;
+  }
+  
+  F_LOG(L_MSG, "Load dropped, resuming acquisition.");
+  OpenEitFilters();
+  if (ettsDeferred) {
+    ettsDeferred = false;
+    OpenEttFilters();
+  }
+}
+
+
+//----------------------------------------------------------------------------
+
+// The claimed slots are complete, look for more or finish the transponder
+void cATSCFilter::FinishWork(void)
+{
+  // Stop looking for ETTs
+  for(std::list<uint16_t>::iterator i = ettPids.begin(); i != ettPids.end(); i++) {
+    Del(*i, 0xCC);
+  }
+  ettPids.clear();
+  
+  bool complete = FilterManager.Finish(memberId, Transponder(), newMGTVersion, claimedSlots);
+  claimedSlots.clear();
+  
+  if (complete)
+    AcquisitionComplete();
+  else
+    ClaimWork();
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cATSCFilter::BeyondHorizon(uint16_t tableType)
+{
+  // EIT-k and ETT-k each cover 3 hours, starting with the current time slot
+  if ((tableType >= 0x0100 && tableType <= 0x017F) || (tableType >= 0x0200 && tableType <= 0x027F))
+    return (tableType & 0x7F) >= config.epgHorizon * 8;
+    
+  return false;
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cATSCFilter::IsStale(uint16_t tableType, uint8_t version)
+{
+  return PsipCache.GetTableVersion(Transponder(), tableType) != version;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cATSCFilter::AcquisitionComplete(void)
+{
+  PsipCache.SetVersions(Transponder(), newMGTVersion, tableVersions);
+  FilterManager.SetMgtVersion(Transponder(), newMGTVersion);
+  FilterManager.SetAcquired(Transponder());
+  GuideGrid.Invalidate();
+  XmltvExport.Trigger(Transponder());
+  gotMGT = false; // Start looking for new versions
+  waiting = false;
+}
+
+
 //----------------------------------------------------------------------------
 
 bool cATSCFilter::ProcessVCT(const uint8_t* data, int length)
 {
-  VCT vct(data, length);
-  if (!vct.CheckCRC())
+  // A corrupt section must not abort a running acquisition
+  if (!PSIPTable::IsValid(data, length))
     return false;
-
-  currentTID = vct.TID();
-  sidTranslator.Update(&vct);
     
-  for (u32 i=0; i<vct.NumberOfChannels(); i++) 
+  uint16_t tsid = VCTChannelMap::ExtractTID(data);
+  uint8_t version = PSIPTable::ExtractVersion(data);
+  
+  if (gotVCT) 
   {
-    F_LOG(L_EIT, "  PMT SID: %d --> VCT SID: %d", vct.GetChannel(i)->ProgramNumber(), vct.GetChannel(i)->Sid());
-    if (vct.GetChannel(i)->HasEit())
-      channelSIDs.push_back( vct.GetChannel(i)->Sid() );
+    if (channelDirectory.TSID() == tsid && channelDirectory.Version() == version) {
+      F_LOG(L_DBG, "VCT: channel map confirmed.");
+      return true;
+    }
+    
+    F_LOG(L_MSG, "VCT: channel map changed since last visit, restarting.");
+    StopAcquisition();
   }
   
-  channelSIDs.sort();
-  channelSIDs.unique();
+  ChannelMap channelMap;
+  if (FilterManager.GetChannelMap(tsid, version, channelMap))
+    F_LOG(L_DBG, "VCT: known version (TSID: %d, version: %d)", tsid, version);
+  else {
+    VCTChannelMap vct(data, length);
+    if (!vct.CheckCRC())
+      return false;
+    channelMap = vct.Map();
+  }
+  
+  FilterManager.PutChannelMap(Transponder(), channelMap);
+  SetChannelMap(channelMap);
+  
+  if (config.updateChannels && !ChannelUpdater.IsCurrent(tsid, version) && Channel() && Channel()->Number())
+    ChannelUpdater.Queue(Channel(), data, length);
    
   return true;
 }
 
 
+//----------------------------------------------------------------------------
+
+void cATSCFilter::SetChannelMap(const ChannelMap& channelMap)
+{
+  channelDirectory.Update(channelMap);
+  if (PsipCache.SetChannels(Transponder(), channelMap))
+    FilterManager.ClearMgtVersion(Transponder());
+  
+  channelSIDs.clear();
+  for (unsigned int i=0; i<channelMap.channels.size(); i++) 
+  {
+    const ChannelMap::Entry& e = channelMap.channels[i];
+    F_LOG(L_EIT, "  PMT SID: %d --> VCT SID: %d", e.programNumber, e.sourceId);
+    if (e.hasEit)
+      channelSIDs.push_back(e.sourceId);
+  }
+  
+  channelSIDs.sort();
+  channelSIDs.unique();
+}
+
+
+//----------------------------------------------------------------------------
+
+void cATSCFilter::StopAcquisition(void)
+{
+  for (std::list<uint32_t>::iterator i = eitPids.begin(); i != eitPids.end(); i++)
+    Del(*i & 0xFFFF, 0xCB);
+  for (std::list<uint16_t>::iterator i = ettPids.begin(); i != ettPids.end(); i++)
+    Del(*i, 0xCC);
+    
+  sections.Clear();
+  eitPids.clear();
+  ettEIDs.clear();
+  ettPids.clear();
+  pendingEitPids.clear();
+  openEitPids.clear();
+  ettsDeferred = false;
+  tableVersions.clear();
+  slotEitPids.clear();
+  slotEttPids.clear();
+  claimedSlots.clear();
+  FilterManager.Release(memberId);
+  
+  waiting = false;
+  gotMGT = false;
+  lastScanMGT = 0;
+}
+
+
 //----------------------------------------------------------------------------
 
 bool cATSCFilter::ProcessEIT(const uint8_t* data, int length, uint16_t Pid)
@@ -395,42 +711,93 @@ bool cATSCFilter::ProcessEIT(const uint8_t* data, int length, uint16_t Pid)
         F_LOG(L_EIT, ">> %s", eit.GetEvent(i)->TitleText());
       */
     }
+    CheckEITsDone();
+    return true;
   }  
-  else // Add events to schedule 
-  {
-    EIT eit(data, length);
-    if (!eit.CheckCRC())
-      return false;
+  
+  // Claimed until committed, a CRC error puts it back
+  eitPids.erase(itr);
+  
+  if (cSectionJob* job = SectionPool.Submit(Pid, data, length)) {
+    sections.Push(job);
+    return true;
+  }
+  
+  EIT eit(data, length);
+  return CommitEIT(eit, Pid, sid);
+}
+
+
+//----------------------------------------------------------------------------
 
-    F_LOG(L_EIT, "Received EIT (SID: %d PID: 0x%04X) [%d left]", sid, Pid , eitPids.size() );
-    eitPids.erase(itr);
-    Del(Pid, 0xCB);
+// A section that fails the CRC check has no source id of its own, its claim
+// is put back under the one from the header it was received with
+bool cATSCFilter::CommitEIT(const EIT& eit, uint16_t Pid, uint16_t sourceId)
+{
+  if (!eit.CheckCRC()) {
+    eitPids.push_back((((u32) sourceId) << 16) | Pid);
+    return false;
+  }
+  
+  // Read again later if the channels stay locked
+  if (!Channels.Lock(false, CHANNELS_LOCK_TIMEOUT)) {
+    eitPids.push_back((((u32) sourceId) << 16) | Pid);
+    return false;
+  }
+  VDRInterface::AddEvents(GetChannel(eit.SourceID()), eit);
+  Channels.Unlock();
     
-    VDRInterface::AddEvents(GetChannel(eit.SourceID()), eit);
-      
-    // Now look for ETTs for these events
-    for (u32 i=0; i<eit.NumberOfEvents(); i++)
-    {
-      const Event* e = eit.GetEvent(i);
-      if (e->ETM_location == 0x01 || e->ETM_location == 0x02) // There is an ETT for this event
-        ettEIDs.push_back(e->event_id);
-    }
+  F_LOG(L_EIT, "Received EIT (SID: %d PID: 0x%04X) [%d left]", eit.SourceID(), Pid , eitPids.size() );
+  Del(Pid, 0xCB);
+  
+  std::map<uint16_t, int>::iterator open = openEitPids.find(Pid);
+  if (open != openEitPids.end() && --open->second <= 0) {
+    openEitPids.erase(open);
+    OpenEitFilters();
   }
+  
+  PsipCache.AddEvents(Transponder(), eit);
     
-  if (eitPids.size() == 0) 
+  // Now look for ETTs for these events
+  for (u32 i=0; i<eit.NumberOfEvents(); i++)
   {
-    F_LOG(L_MSG, "Received all EITs.");
-
-    // Now start looking for ETTs
-    for(std::list<uint16_t>::iterator i = ettPids.begin(); i != ettPids.end(); i++) {
-      Add(*i, 0xCC);
-    } 
+    const Event* e = eit.GetEvent(i);
+    if (e->ETM_location == 0x01 || e->ETM_location == 0x02) // There is an ETT for this event
+      ettEIDs.push_back(e->event_id);
   }
   
+  CheckEITsDone();
   return true;
 }
 
 
+//----------------------------------------------------------------------------
+
+void cATSCFilter::CheckEITsDone(void)
+{
+  if (eitPids.size() != 0 || !sections.Empty() || claimedSlots.empty()) 
+    return;
+    
+  F_LOG(L_MSG, "Received all EITs.");
+
+  if (ettEIDs.size() == 0) {
+    F_LOG(L_MSG, "No ETTs to receive.");
+    FinishWork();
+    return;
+  }
+
+  if (throttled) {
+    if (!ettsDeferred)
+      F_LOG(L_MSG, "Deferring ETTs while throttled.");
+    ettsDeferred = true;
+    return;
+  }
+  
+  // Now start looking for ETTs
+  OpenEttFilters();
+}
+
+
 //----------------------------------------------------------------------------
 
 bool cATSCFilter::ProcessETT(const uint8_t* data, int length)
@@ -442,51 +809,76 @@ bool cATSCFilter::ProcessETT(const uint8_t* data, int length)
   if (itr == ettEIDs.end()) 
   {
     F_LOG(L_ETT, "Unexpected ETT (EID: %d)", eid);
+    CheckETTsDone();
+    return true;
   }
-  else
-  {
-    ETT ett(data, length);
-    if (!ett.CheckCRC())
-      return false;
-
-    F_LOG(L_ETT, "Received ETT (EID: %d)", eid);
-    ettEIDs.erase(itr);
-    // We cannot Del(Pid, Tid) because we do not know how many ETTs 
-    // we will get per PID. Or maybe there is a way to know this...
-    VDRInterface::AddDescription(GetChannel(ett.SourceID()), ett);
+  
+  // Claimed until committed, a CRC error puts it back
+  ettEIDs.erase(itr);
+  
+  if (cSectionJob* job = SectionPool.Submit(0, data, length)) {
+    sections.Push(job);
+    return true;
   }
-    
-  if (ettEIDs.size() == 0) 
-  {
-    F_LOG(L_MSG, "Received all ETTs.");
-    F_LOG(L_MSG, "Got all event information for this transport stream.");
+  
+  ETT ett(data, length);
+  return CommitETT(ett, eid);
+}
 
-    // Stop looking for ETTs
-    for(std::list<uint16_t>::iterator i = ettPids.begin(); i != ettPids.end(); i++) {
-      Del(*i, 0xCC);
-    }
-    
-    FilterManager.SetMgtVersion(Transponder(), newMGTVersion);
-    gotMGT = false; // Start looking for new versions
+
+//----------------------------------------------------------------------------
+
+bool cATSCFilter::CommitETT(const ETT& ett, uint16_t eventId)
+{
+  if (!ett.CheckCRC()) {
+    ettEIDs.push_back(eventId);
+    return false;
   }
   
+  if (!Channels.Lock(false, CHANNELS_LOCK_TIMEOUT)) {
+    ettEIDs.push_back(eventId);
+    return false;
+  }
+  VDRInterface::AddDescription(GetChannel(ett.SourceID()), ett);
+  Channels.Unlock();
+
+  F_LOG(L_ETT, "Received ETT (EID: %d)", ett.EventID());
+  // We cannot Del(Pid, Tid) because we do not know how many ETTs 
+  // we will get per PID. Or maybe there is a way to know this...
+  PsipCache.AddText(Transponder(), ett);
+  
+  CheckETTsDone();
   return true; 
 }
 
 
 //----------------------------------------------------------------------------
 
-cChannel* cATSCFilter::GetChannel(uint16_t vctSid) const
+void cATSCFilter::CheckETTsDone(void)
 {
-  cChannel* channel = NULL;
-  uint16_t pmtSid = sidTranslator.GetPmtSid(vctSid);
-  if (pmtSid)
+  if (ettEIDs.size() != 0 || !sections.Empty() || claimedSlots.empty()) 
+    return;
+    
+  F_LOG(L_MSG, "Received all ETTs.");
+  F_LOG(L_MSG, "Got all event information for the claimed slots.");
+  FinishWork();
+}
+
+
+//----------------------------------------------------------------------------
+
+// Commits the sections parsed by the pool, in the order they were received
+void cATSCFilter::CommitSections(void)
+{
+  while (cSectionJob* job = sections.Pop())
   {
-    tChannelID channelIDSearch(cSource::stAtsc, 0x00, currentTID, pmtSid);
-    channel = Channels.GetByChannelID(channelIDSearch, true);  
+    if (job->Tid() == 0xCB)
+      CommitEIT(*(const EIT*) job->Table(), job->Pid(), EIT::ExtractSourceID(job->Data()));
+    else
+      CommitETT(*(const ETT*) job->Table(), ETT::ExtractEventID(job->Data()));
+    SectionPool.Committed(job);
+    SectionPool.Release(job);
   }
-  
-  return channel;
 }
 
 
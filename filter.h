@@ -21,11 +21,14 @@
 #define __ATSCFILTER_H
 
 #include <list>
+#include <map>
 
 #include <vdr/filter.h>
 #include <vdr/device.h>
 
 #include "vdrInterface.h"
+#include "sectionPool.h"
+#include "sectionLimiter.h"
  
 
 //////////////////////////////////////////////////////////////////////////////
@@ -34,7 +37,7 @@
 class cATSCFilter : public cFilter
 {  
 public:
-  cATSCFilter(int num);
+  cATSCFilter(int num, cDevice* Device);
   virtual ~cATSCFilter();
   
 protected:
@@ -48,8 +51,24 @@ private:
   bool ProcessVCT(const uint8_t* data, int length);
   bool ProcessEIT(const uint8_t* data, int length, uint16_t Pid);
   bool ProcessETT(const uint8_t* data, int length);
+  bool CommitEIT(const EIT& eit, uint16_t Pid, uint16_t sourceId);
+  bool CommitETT(const ETT& ett, uint16_t eventId);
+  void CommitSections(void);
+  void CheckEITsDone(void);
+  void CheckETTsDone(void);
   
-  cChannel* GetChannel(uint16_t sid) const;
+  void SetChannelMap(const ChannelMap& channelMap);
+  void StopAcquisition(void);
+  static bool BeyondHorizon(uint16_t tableType);
+  bool IsStale(uint16_t tableType, uint8_t version);
+  bool ClaimWork(void);
+  void FinishWork(void);
+  void OpenEitFilters(void);
+  void OpenEttFilters(void);
+  void CheckLoad(void);
+  void AcquisitionComplete(void);
+  
+  cChannel* GetChannel(uint16_t sourceId) { return channelDirectory.GetChannel(sourceId); }
   
   void ResetFilter(void);
 
@@ -60,17 +79,30 @@ private:
   
   bool gotMGT;
   bool gotVCT;
-  bool gotRRT;
+  bool vctConfirmed; // gotVCT may be set from the map seen on the last visit
+  bool waiting;      // For other filters to finish the slots they claimed
+  bool throttled;    // The device is recording or parsing is falling behind
+  bool ettsDeferred; // Until the load drops
+  time_t lastLoadCheck;
   
   int fNum;
+  int memberId; // In the filter manager
+  cDevice* device;
   
   std::list<uint16_t> channelSIDs;
   std::list<uint32_t> eitPids; // SID << 16 | PID
   std::list<uint16_t> ettEIDs;
   std::list<uint16_t> ettPids;
+  std::list<uint16_t> pendingEitPids;   // Claimed, filter not opened yet
+  std::map<uint16_t, int> openEitPids; // PID -> EITs still to come
+  std::map<uint16_t, uint8_t> tableVersions; // From the MGT being acquired
+  std::map<uint8_t, uint16_t> slotEitPids;   // Slots to acquire
+  std::map<uint8_t, uint16_t> slotEttPids;
+  std::vector<uint8_t> claimedSlots;
   
-  SidTranslator sidTranslator;
-  uint16_t currentTID;
+  ChannelDirectory channelDirectory;
+  cSectionQueue sections; // Submitted to the section pool, oldest first
+  cSectionLimiter limiter;
 };
 
 
@@ -40,56 +40,218 @@ cFilterManager::cFilterManager(void)
 
 cFilterManager::~cFilterManager()
 {
+  for (std::map<int, Acquisition*>::iterator i = acquisitions.begin(); i != acquisitions.end(); i++)
+    delete i->second;
+}
+
 
+//----------------------------------------------------------------------------
+
+int cFilterManager::AddFilter(const cATSCFilter* filter)
+{
+  // One bit per filter in Acquisition::members, MAXDEVICES is at most 16
+  cMutexLock lock(&mutex);
+  return numFilters++;
 }
 
 
 //----------------------------------------------------------------------------
 
-void cFilterManager::AddFilter(const cATSCFilter* filter)
+cFilterManager::Acquisition* cFilterManager::GetAcquisition(int transponder)
 {
-  if (numFilters < MAXDEVICES)
-  {
-    map[numFilters].filter = filter;
-    map[numFilters].ts     = -1;
-    numFilters++;
+  cMutexLock lock(&mutex);
+  
+  Acquisition*& a = acquisitions[transponder];
+  if (!a) {
+    a = new Acquisition;
+    a->mgtVersion = -1;
+    a->complete = false;
+    a->members = 0;
+    a->bytes = 0;
+    for (int k=0; k<NUM_SLOTS; k++)
+      a->slots[k] = SLOT_UNUSED;
   }
+  return a;
 }
 
 
 //----------------------------------------------------------------------------
 
-bool cFilterManager::Set(const cATSCFilter* filter, int transponder)
+void cFilterManager::Set(int filter, int transponder)
+{
+  __sync_fetch_and_or(&GetAcquisition(transponder)->members, 1u << filter);
+}
+
+
+//----------------------------------------------------------------------------
+
+// Hands the slots claimed by the filter back to the others on the transponder
+void cFilterManager::Release(int filter)
 {
   cMutexLock lock(&mutex);
+  for (std::map<int, Acquisition*>::iterator i = acquisitions.begin(); i != acquisitions.end(); i++)
+    for (int k=0; k<NUM_SLOTS; k++)
+      __sync_bool_compare_and_swap(&i->second->slots[k], filter + 1, SLOT_FREE);
+}
+
+
+//----------------------------------------------------------------------------
+
+void cFilterManager::Reset(int filter)
+{
+  Release(filter);
   
-  for (int i=0; i<numFilters; i++)
-    if (map[i].ts == transponder && map[i].filter != filter)
-    { // Another filter is updating this transponder
-      return false;
-    }
+  cMutexLock lock(&mutex);
+  for (std::map<int, Acquisition*>::iterator i = acquisitions.begin(); i != acquisitions.end(); i++)
+    __sync_fetch_and_and(&i->second->members, ~(1u << filter));
+}
+
+
+//----------------------------------------------------------------------------
+
+// Starts a new acquisition of the given slots, unless one is already under way
+void cFilterManager::BeginAcquisition(int transponder, uint8_t mgtVersion, const std::vector<uint8_t>& slots, int bytes)
+{
+  Acquisition* a = GetAcquisition(transponder);
+  
+  cMutexLock lock(&mutex);
+  if (a->mgtVersion == mgtVersion && !a->complete)
+    return;
     
-  for (int i=0; i<numFilters; i++)
-    if (map[i].filter == filter) {
-      map[i].ts = transponder;
-      break;
+  a->mgtVersion = mgtVersion;
+  a->complete = false;
+  a->bytes = bytes;
+  for (int k=0; k<NUM_SLOTS; k++)
+    a->slots[k] = SLOT_UNUSED;
+  for (size_t i=0; i<slots.size(); i++)
+    a->slots[slots[i] % NUM_SLOTS] = SLOT_FREE;
+}
+
+
+//----------------------------------------------------------------------------
+
+// Claims a fair share of the slots still to be acquired: those not done
+// divided by the filters on the transponder, less what the filter already 
+// holds. Returns the number claimed, or -1 if the acquisition has moved on 
+// to another MGT version.
+int cFilterManager::Claim(int filter, int transponder, uint8_t mgtVersion, std::vector<uint8_t>& slots)
+{
+  slots.clear();
+  Acquisition* a = GetAcquisition(transponder);
+  if (a->mgtVersion != mgtVersion)
+    return -1;
+  
+  int members = __builtin_popcount(a->members | (1u << filter));
+  int owner = filter + 1;
+  
+  int undone = 0, mine = 0;
+  for (int k=0; k<NUM_SLOTS; k++) 
+  {
+    int s = a->slots[k];
+    if (s >= SLOT_FREE)
+      undone++;
+    if (s == owner)
+      mine++;
+  }
+  
+  int share = (undone + members - 1) / members - mine;
+  for (int k=0; k<NUM_SLOTS && share > 0; k++)
+    if (__sync_bool_compare_and_swap(&a->slots[k], SLOT_FREE, owner)) {
+      slots.push_back(k);
+      share--;
     }
     
+  return slots.size();
+}
+
+
+//----------------------------------------------------------------------------
+
+// Marks the slots as acquired. Returns true for the filter that completed
+// the transponder.
+bool cFilterManager::Finish(int filter, int transponder, uint8_t mgtVersion, const std::vector<uint8_t>& slots)
+{
+  Acquisition* a = GetAcquisition(transponder);
+  int owner = filter + 1;
+  
+  cMutexLock lock(&mutex);
+  if (a->mgtVersion != mgtVersion || a->complete)
+    return false;
+    
+  for (size_t i=0; i<slots.size(); i++)
+    __sync_bool_compare_and_swap(&a->slots[slots[i] % NUM_SLOTS], owner, SLOT_DONE);
+    
+  for (int k=0; k<NUM_SLOTS; k++)
+    if (a->slots[k] >= SLOT_FREE)
+      return false;
+      
+  a->complete = true;
   return true;
 }
 
 
 //----------------------------------------------------------------------------
 
-void cFilterManager::Reset(const cATSCFilter* filter)
+bool cFilterManager::Complete(int transponder, uint8_t mgtVersion)
 {
+  Acquisition* a = GetAcquisition(transponder);
+  
   cMutexLock lock(&mutex);
+  return a->mgtVersion == mgtVersion && a->complete;
+}
+
+
+//----------------------------------------------------------------------------
+
+// Bytes of the tables still to acquire, -1 if no MGT has been seen yet
+int cFilterManager::PendingBytes(int transponder)
+{
+  Acquisition* a = GetAcquisition(transponder);
   
-  for (int i=0; i<numFilters; i++)
-    if (map[i].filter == filter) {
-      map[i].ts = -1;
-      return;
-    }
+  cMutexLock lock(&mutex);
+  if (a->mgtVersion < 0)
+    return -1;
+  return a->complete ? 0 : a->bytes;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cFilterManager::SetAcquired(int transponder)
+{
+  cMutexLock lock(&mutex);
+  acquired[transponder] = time(NULL);
+}
+
+
+//----------------------------------------------------------------------------
+
+time_t cFilterManager::LastAcquired(int transponder)
+{
+  cMutexLock lock(&mutex);
+  std::map<int, time_t>::const_iterator itr = acquired.find(transponder);
+  return itr != acquired.end() ? itr->second : 0;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cFilterManager::SetScanHarvest(int transponder, bool On)
+{
+  cMutexLock lock(&mutex);
+  if (On)
+    scanHarvests.insert(transponder);
+  else
+    scanHarvests.erase(transponder);
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cFilterManager::IsScanHarvest(int transponder)
+{
+  cMutexLock lock(&mutex);
+  return scanHarvests.find(transponder) != scanHarvests.end();
 }
 
 
@@ -116,6 +278,75 @@ void cFilterManager::SetMgtVersion(int transponder, uint8_t version)
 }
 
 
+//----------------------------------------------------------------------------
+
+void cFilterManager::ClearMgtVersion(int transponder)
+{
+  cMutexLock lock(&mutex);
+  MGTVersions.erase(transponder);
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cFilterManager::GetChannelMap(uint16_t tsid, uint8_t version, ChannelMap& channelMap)
+{
+  cMutexLock lock(&mutex);
+  
+  std::map<uint32_t, ChannelMap>::const_iterator itr = channelMaps.find(((uint32_t) tsid << 8) | version);
+  if (itr == channelMaps.end())
+    return false;
+    
+  channelMap = itr->second;
+  return true;
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cFilterManager::GetLastChannelMap(int transponder, ChannelMap& channelMap)
+{
+  cMutexLock lock(&mutex);
+  
+  std::map<int, uint32_t>::const_iterator itr = lastChannelMaps.find(transponder);
+  if (itr == lastChannelMaps.end())
+    return false;
+    
+  channelMap = channelMaps[itr->second];
+  return true;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cFilterManager::PutChannelMap(int transponder, const ChannelMap& channelMap)
+{
+  cMutexLock lock(&mutex);
+  
+  uint32_t key = ((uint32_t) channelMap.tsid << 8) | channelMap.version;
+  
+  // Only keep the latest version of each transport stream
+  std::map<int, uint32_t>::iterator last = lastChannelMaps.find(transponder);
+  if (last != lastChannelMaps.end() && last->second != key && (last->second >> 8) == channelMap.tsid)
+    channelMaps.erase(last->second);
+  
+  channelMaps[key] = channelMap;
+  lastChannelMaps[transponder] = key;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cFilterManager::GetTransponders(std::vector<int>& transponders)
+{
+  cMutexLock lock(&mutex);
+  
+  transponders.clear();
+  for (std::map<int, uint32_t>::const_iterator itr = lastChannelMaps.begin(); itr != lastChannelMaps.end(); itr++)
+    transponders.push_back(itr->first);
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 
 
@@ -21,15 +21,21 @@
 #define __ATSC_FILTER_MANAGER_H
 
 #include <map> 
+#include <set>
+#include <vector>
 
 #include <vdr/device.h>
 #include <vdr/thread.h>
 
+#include "structs.h"
+
 
 ///////////////////////////////////////////////////////////////////////////////
 
 class cATSCFilter;
 
+#define NUM_SLOTS 128 // EIT-0 to EIT-127
+
 ///////////////////////////////////////////////////////////////////////////////
 
 
@@ -39,23 +45,53 @@ public:
   cFilterManager(void);
  ~cFilterManager();
  
-  void AddFilter(const cATSCFilter* filter);
+  int  AddFilter(const cATSCFilter* filter);
+  
+  // Filters on the same transponder share the EIT-k/ETT-k slots to acquire
+  void Set(int filter, int transponder);
+  void Reset(int filter);
+  void Release(int filter);
+  void BeginAcquisition(int transponder, uint8_t mgtVersion, const std::vector<uint8_t>& slots, int bytes);
+  int  Claim(int filter, int transponder, uint8_t mgtVersion, std::vector<uint8_t>& slots);
+  bool Finish(int filter, int transponder, uint8_t mgtVersion, const std::vector<uint8_t>& slots);
+  bool Complete(int transponder, uint8_t mgtVersion);
+  int  PendingBytes(int transponder);
+  void SetAcquired(int transponder);
+  time_t LastAcquired(int transponder);
   
-  bool Set(const cATSCFilter* filter, int transponder);
-  void Reset(const cATSCFilter* filter);
+  // Transponders a channel scan is harvesting the guide of
+  void SetScanHarvest(int transponder, bool On);
+  bool IsScanHarvest(int transponder);
   
   int  GetMgtVersion(int transponder);
   void SetMgtVersion(int transponder, uint8_t version);
+  void ClearMgtVersion(int transponder);
+  
+  bool GetChannelMap(uint16_t tsid, uint8_t version, ChannelMap& channelMap);
+  bool GetLastChannelMap(int transponder, ChannelMap& channelMap);
+  void PutChannelMap(int transponder, const ChannelMap& channelMap);
+  void GetTransponders(std::vector<int>& transponders);
   
 private:
   std::map<int, uint8_t> MGTVersions;
+  std::map<uint32_t, ChannelMap> channelMaps; // TSID << 8 | version
+  std::map<int, uint32_t> lastChannelMaps;    // Last map seen on a transponder
+  
+  enum { SLOT_UNUSED = -2, SLOT_DONE = -1, SLOT_FREE = 0 }; // Else owner + 1
   
-  struct FilterPair {
-    const cATSCFilter* filter;
-    int ts;
+  struct Acquisition {
+    volatile int mgtVersion;
+    volatile bool complete;
+    volatile uint32_t members; // Bit per filter
+    int bytes; // Of the tables being acquired, from the MGT
+    volatile int slots[NUM_SLOTS];
   };
   
-  FilterPair map[MAXDEVICES];
+  Acquisition* GetAcquisition(int transponder);
+  
+  std::map<int, Acquisition*> acquisitions;
+  std::map<int, time_t> acquired; // When the last acquisition completed
+  std::set<int> scanHarvests;
   int numFilters;
   
   cMutex mutex;
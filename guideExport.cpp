@@ -0,0 +1,320 @@
+/*
+ * Copyright (C) 2006-2010 Alex Lasnier <alex@fepg.org>
+ *
+ * This file is part of ATSC EPG
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <algorithm>
+
+#include "guideExport.h"
+#include "guideStore.h"
+#include "config.h"
+#include "tools.h"
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+#define SLOT_SECONDS  1800 // The period covered moves in 30 minute steps
+#define PAST_SECONDS  3600
+#define HEADER_SPACE  4096 // Buffers start on a page boundary
+#define MIN_BUFFER    (1024 * 1024)
+
+cGuideExport GuideExport;
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+// Orders channel indices by virtual channel number
+class cChannelOrder
+{
+public:
+  cChannelOrder(const std::vector<cGuideStore::WindowChannel>& Channels) : channels(Channels) {}
+  
+  bool operator()(uint32_t a, uint32_t b) const
+  {
+    const cGuideStore::WindowChannel& x = channels[a];
+    const cGuideStore::WindowChannel& y = channels[b];
+    if (x.majorNumber != y.majorNumber)
+      return x.majorNumber < y.majorNumber;
+    if (x.minorNumber != y.minorNumber)
+      return x.minorNumber < y.minorNumber;
+    return a < b;
+  }
+  
+private:
+  const std::vector<cGuideStore::WindowChannel>& channels;
+};
+
+
+//----------------------------------------------------------------------------
+
+static bool EventBefore(const SharedGuideEvent& a, const SharedGuideEvent& b)
+{
+  if (a.channel != b.channel)
+    return a.channel < b.channel;
+  return a.startTime < b.startTime;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+cGuideExport::cGuideExport(void)
+{
+  header = NULL;
+  mapSize = 0;
+  generation = 0;
+  start = 0;
+  valid = false;
+}
+
+
+//----------------------------------------------------------------------------
+
+cGuideExport::~cGuideExport()
+{
+  Close();
+}
+
+
+//----------------------------------------------------------------------------
+
+void cGuideExport::SetFileName(const char* FileName)
+{
+  cMutexLock lock(&mutex);
+  fileName = FileName;
+  valid = false;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cGuideExport::Update(bool force)
+{
+  cMutexLock lock(&mutex);
+  
+  if (!Enabled())
+    return;
+    
+  uint32_t gen = GuideStore.Generation();
+  time_t now = time(NULL);
+  time_t newStart = now - now % SLOT_SECONDS - PAST_SECONDS;
+  
+  if (!force && valid && gen == generation && newStart == start)
+    return;
+    
+  start = newStart;
+  generation = gen;
+  
+  std::vector<char> snapshot;
+  Build(snapshot);
+  Publish(snapshot);
+  valid = true;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cGuideExport::Build(std::vector<char>& data)
+{
+  time_t end = start + PAST_SECONDS + config.epgHorizon * 24 * 3600;
+  
+  std::vector<cGuideStore::WindowChannel> channels;
+  std::vector<cGuideStore::WindowEvent> events;
+  std::vector<std::string> strings;
+  GuideStore.GetWindow(start, end, channels, events, strings, true);
+  
+  std::vector<uint32_t> order(channels.size());
+  for (unsigned int i=0; i<order.size(); i++)
+    order[i] = i;
+  std::sort(order.begin(), order.end(), cChannelOrder(channels));
+  
+  std::vector<uint32_t> channelOf(channels.size());
+  for (unsigned int i=0; i<order.size(); i++)
+    channelOf[order[i]] = i;
+    
+  // Strings blob, offset 0 is the empty string
+  std::vector<uint32_t> stringOffset(strings.size());
+  size_t stringsSize = 1;
+  for (unsigned int i=0; i<strings.size(); i++) {
+    stringOffset[i] = stringsSize;
+    stringsSize += strings[i].size() + 1;
+  }
+  
+  SharedGuideSnapshot s;
+  s.published = time(NULL);
+  s.start = start;
+  s.end = end;
+  s.numChannels = channels.size();
+  s.numEvents = events.size();
+  s.channelsOffset = sizeof(SharedGuideSnapshot);
+  s.eventsOffset = s.channelsOffset + s.numChannels * sizeof(SharedGuideChannel);
+  s.stringsOffset = s.eventsOffset + s.numEvents * sizeof(SharedGuideEvent);
+  s.stringsSize = stringsSize;
+  
+  data.assign(s.stringsOffset + stringsSize, 0);
+  memcpy(&data[0], &s, sizeof(s));
+  
+  SharedGuideEvent* ev = (SharedGuideEvent*) &data[s.eventsOffset];
+  for (unsigned int i=0; i<events.size(); i++) {
+    ev[i].startTime = events[i].startTime;
+    ev[i].duration = events[i].duration;
+    ev[i].eventId = events[i].eventId;
+    ev[i].channel = channelOf[events[i].channel];
+    ev[i].title = stringOffset[events[i].title];
+    ev[i].description = (events[i].text != cGuideStore::NO_TEXT) ? stringOffset[events[i].text] : 0;
+  }
+  std::sort(ev, ev + s.numEvents, EventBefore);
+  
+  SharedGuideChannel* ch = (SharedGuideChannel*) &data[s.channelsOffset];
+  for (unsigned int i=0; i<order.size(); i++) {
+    const cGuideStore::WindowChannel& c = channels[order[i]];
+    ch[i].tsid = c.channelID.Tid();
+    ch[i].programNumber = c.channelID.Sid();
+    ch[i].majorNumber = c.majorNumber;
+    ch[i].minorNumber = c.minorNumber;
+    ch[i].firstEvent = 0;
+    ch[i].numEvents = 0;
+  }
+  for (unsigned int i=s.numEvents; i>0; i--) {
+    ch[ev[i-1].channel].firstEvent = i - 1;
+    ch[ev[i-1].channel].numEvents++;
+  }
+  
+  char* blob = &data[s.stringsOffset];
+  for (unsigned int i=0; i<strings.size(); i++)
+    memcpy(blob + stringOffset[i], strings[i].c_str(), strings[i].size() + 1);
+    
+  dprint(L_DBG, "Shared guide: %d channel(s), %d event(s), %d bytes.", s.numChannels, s.numEvents, (int) data.size());
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cGuideExport::Create(size_t bufferSize)
+{
+  bufferSize = (bufferSize + HEADER_SPACE - 1) / HEADER_SPACE * HEADER_SPACE;
+  size_t size = HEADER_SPACE + 2 * bufferSize;
+  
+  cString tmpName = cString::sprintf("%s.tmp", *fileName);
+  int fd = open(tmpName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    dprint(L_ERR, "Shared guide: cannot create %s.", *tmpName);
+    return false;
+  }
+  
+  void* map = MAP_FAILED;
+  if (ftruncate(fd, size) == 0)
+    map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    dprint(L_ERR, "Shared guide: cannot map %s.", *tmpName);
+    unlink(tmpName);
+    return false;
+  }
+  
+  SharedGuideHeader* h = (SharedGuideHeader*) map;
+  memcpy(h->magic, SHARED_GUIDE_MAGIC, sizeof(h->magic));
+  h->version = SHARED_GUIDE_VERSION;
+  h->flags = 0;
+  h->sequence = 0;
+  h->active = 0;
+  h->generation = header ? header->generation : 0;
+  h->bufferOffset[0] = HEADER_SPACE;
+  h->bufferOffset[1] = HEADER_SPACE + bufferSize;
+  h->bufferSize = bufferSize;
+  
+  if (header) {
+    // Keep the current snapshot readable until the new one is published
+    memcpy((char*) map + h->bufferOffset[0], (char*) header + header->bufferOffset[header->active], header->bufferSize);
+  }
+  
+  // Left by a previous run, readers only learn about the new file this way
+  if (!header) {
+    int old = open(fileName, O_RDWR);
+    SharedGuideHeader oldHeader;
+    if (old >= 0 && pread(old, &oldHeader, sizeof(oldHeader), 0) == sizeof(oldHeader) && memcmp(oldHeader.magic, SHARED_GUIDE_MAGIC, sizeof(oldHeader.magic)) == 0) {
+      oldHeader.flags |= SHARED_GUIDE_STALE;
+      if (pwrite(old, &oldHeader.flags, sizeof(oldHeader.flags), offsetof(SharedGuideHeader, flags)) != sizeof(oldHeader.flags))
+        dprint(L_ERR, "Shared guide: cannot mark the previous file stale.");
+    }
+    if (old >= 0)
+      close(old);
+  }
+  
+  if (rename(tmpName, fileName) != 0) {
+    dprint(L_ERR, "Shared guide: cannot replace %s.", *fileName);
+    munmap(map, size);
+    unlink(tmpName);
+    return false;
+  }
+  
+  // Tell readers of the previous file to reopen
+  if (header) {
+    header->flags |= SHARED_GUIDE_STALE;
+    munmap(header, mapSize);
+  }
+  
+  header = h;
+  mapSize = size;
+  return true;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cGuideExport::Publish(const std::vector<char>& snapshot)
+{
+  if (!header || snapshot.size() > header->bufferSize) {
+    if (!Create(std::max(snapshot.size() + snapshot.size() / 2, (size_t) MIN_BUFFER)))
+      return;
+  }
+  
+  uint32_t target = 1 - header->active;
+  memcpy((char*) header + header->bufferOffset[target], &snapshot[0], snapshot.size());
+  
+  __sync_synchronize();
+  header->sequence++;
+  __sync_synchronize();
+  header->active = target;
+  header->generation++;
+  __sync_synchronize();
+  header->sequence++;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cGuideExport::Close(void)
+{
+  cMutexLock lock(&mutex);
+  
+  // The file stays, readers keep the last snapshot
+  if (header)
+    munmap(header, mapSize);
+  header = NULL;
+  mapSize = 0;
+  valid = false;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
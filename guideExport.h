@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2006-2010 Alex Lasnier <alex@fepg.org>
+ *
+ * This file is part of ATSC EPG
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __ATSC_GUIDE_EXPORT_H
+#define __ATSC_GUIDE_EXPORT_H
+
+#include <vector>
+
+#include <vdr/thread.h>
+#include <vdr/tools.h>
+
+#include "sharedGuide.h"
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+// Publishes the guide store to a memory mapped file for programs running 
+// on the same host, see sharedGuide.h for the layout and how to read it.
+class cGuideExport
+{
+public:
+  cGuideExport(void);
+  ~cGuideExport();
+  
+  void SetFileName(const char* FileName);
+  bool Enabled(void) const { return *fileName != NULL; }
+  void Update(bool force = false);
+  void Close(void);
+  
+private:
+  void Build(std::vector<char>& snapshot);
+  bool Create(size_t bufferSize);
+  void Publish(const std::vector<char>& snapshot);
+  
+  cString fileName;
+  SharedGuideHeader* header;
+  size_t mapSize;
+  uint32_t generation; // Of the guide store
+  time_t start;
+  bool valid;
+  cMutex mutex;
+};
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+extern cGuideExport GuideExport;
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+#endif //__ATSC_GUIDE_EXPORT_H
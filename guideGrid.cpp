@@ -0,0 +1,247 @@
+/*
+ * Copyright (C) 2006-2010 Alex Lasnier <alex@fepg.org>
+ *
+ * This file is part of ATSC EPG
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include "guideGrid.h"
+#include "guideStore.h"
+#include "config.h"
+#include "tools.h"
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+#define BUCKET_SECONDS 1800 // 30 minutes
+#define PAST_BUCKETS   2    // Kept before the current one
+
+cGuideGrid GuideGrid;
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+int cGridSnapshot::Slice(time_t from, time_t to, std::vector<const Event*>& result) const
+{
+  result.clear();
+  
+  if (from < start)
+    from = start;
+  if (to > End())
+    to = End();
+  if (from >= to)
+    return 0;
+    
+  int first = (from - start) / bucketSeconds;
+  int last  = (to - 1 - start) / bucketSeconds;
+  int numChannels = channels.size();
+  
+  for (int c=0; c<numChannels; c++)
+  {
+    // Events spanning several buckets are listed in each, cells are in 
+    // event order so only larger indices are new.
+    uint32_t next = 0;
+    for (int b=first; b<=last; b++)
+    {
+      int cell = b * numChannels + c;
+      for (uint32_t i=cellStart[cell]; i<cellStart[cell+1]; i++)
+      {
+        const Event& e = events[cells[i]];
+        if (cells[i] < next || e.startTime >= to || e.startTime + e.duration <= from)
+          continue;
+        result.push_back(&e);
+        next = cells[i] + 1;
+      }
+    }
+  }
+  
+  return result.size();
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+cGuideGrid::cGuideGrid(void)
+{
+  current = NULL;
+  generation = 0;
+  dirty = false;
+}
+
+
+//----------------------------------------------------------------------------
+
+cGuideGrid::~cGuideGrid()
+{
+  Put(current);
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cGuideGrid::ChannelBefore(const cGridSnapshot::Channel& a, const cGridSnapshot::Channel& b)
+{
+  if (a.majorNumber != b.majorNumber)
+    return a.majorNumber < b.majorNumber;
+  if (a.minorNumber != b.minorNumber)
+    return a.minorNumber < b.minorNumber;
+  if (a.channelID.Tid() != b.channelID.Tid())
+    return a.channelID.Tid() < b.channelID.Tid();
+  return a.channelID.Sid() < b.channelID.Sid();
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cGuideGrid::EventBefore(const cGridSnapshot::Event& a, const cGridSnapshot::Event& b)
+{
+  if (a.channel != b.channel)
+    return a.channel < b.channel;
+  return a.startTime < b.startTime;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cGuideGrid::Update(bool force)
+{
+  cMutexLock buildLock(&buildMutex);
+  
+  dirty = false;
+  uint32_t gen = GuideStore.Generation();
+  time_t now = time(NULL);
+  time_t start = now - now % BUCKET_SECONDS - PAST_BUCKETS * BUCKET_SECONDS;
+  int numBuckets = PAST_BUCKETS + 1 + (config.epgHorizon * 24 * 3600) / BUCKET_SECONDS;
+  
+  {
+    cMutexLock lock(&mutex);
+    if (!force && current && gen == generation && current->start == start && current->numBuckets == numBuckets)
+      return;
+  }
+  
+  cGridSnapshot* grid = new cGridSnapshot;
+  grid->start = start;
+  grid->bucketSeconds = BUCKET_SECONDS;
+  grid->numBuckets = numBuckets;
+  
+  std::vector<cGuideStore::WindowChannel> channels;
+  std::vector<cGuideStore::WindowEvent> events;
+  GuideStore.GetWindow(grid->Start(), grid->End(), channels, events, grid->titles);
+  
+  // Channels in virtual channel order
+  for (unsigned int i=0; i<channels.size(); i++) {
+    cGridSnapshot::Channel c;
+    c.channelID = channels[i].channelID;
+    c.majorNumber = channels[i].majorNumber;
+    c.minorNumber = channels[i].minorNumber;
+    grid->channels.push_back(c);
+  }
+  std::sort(grid->channels.begin(), grid->channels.end(), ChannelBefore);
+  
+  std::vector<uint32_t> channelOf(channels.size());
+  for (unsigned int i=0; i<grid->channels.size(); i++)
+    for (unsigned int k=0; k<channels.size(); k++)
+      if (channels[k].channelID == grid->channels[i].channelID) {
+        channelOf[k] = i;
+        break;
+      }
+        
+  grid->events.resize(events.size());
+  for (unsigned int i=0; i<events.size(); i++) {
+    cGridSnapshot::Event& e = grid->events[i];
+    e.channel = channelOf[events[i].channel];
+    e.title = events[i].title;
+    e.startTime = events[i].startTime;
+    e.duration = events[i].duration;
+    e.eventId = events[i].eventId;
+  }
+  std::sort(grid->events.begin(), grid->events.end(), EventBefore);
+  
+  // Count the events of each cell, then fill them in
+  int numChannels = grid->channels.size();
+  grid->cellStart.assign(grid->numBuckets * numChannels + 1, 0);
+  
+  for (int pass=0; pass<2; pass++)
+  {
+    std::vector<uint32_t> fill(grid->cellStart.begin(), grid->cellStart.end() - 1);
+    for (unsigned int i=0; i<grid->events.size(); i++)
+    {
+      const cGridSnapshot::Event& e = grid->events[i];
+      int first = std::max((int) ((e.startTime - start) / BUCKET_SECONDS), 0);
+      int last = std::min((int) ((e.startTime + std::max(e.duration, 1) - 1 - start) / BUCKET_SECONDS), grid->numBuckets - 1);
+      
+      for (int b=first; b<=last; b++) {
+        int cell = b * numChannels + e.channel;
+        if (pass == 0)
+          grid->cellStart[cell + 1]++;
+        else
+          grid->cells[fill[cell]++] = i;
+      }
+    }
+    
+    if (pass == 0) {
+      for (unsigned int k=1; k<grid->cellStart.size(); k++)
+        grid->cellStart[k] += grid->cellStart[k-1];
+      grid->cells.resize(grid->cellStart.back());
+    }
+  }
+  
+  dprint(L_DBG, "Guide grid: %d channel(s), %d event(s).", numChannels, (int) grid->events.size());
+  
+  cGridSnapshot* old;
+  {
+    cMutexLock lock(&mutex);
+    old = current;
+    current = grid;
+    generation = gen;
+  }
+  Put(old);
+}
+
+
+//----------------------------------------------------------------------------
+
+cGridSnapshot* cGuideGrid::Get(void)
+{
+  cMutexLock lock(&mutex);
+  if (current)
+    current->refs++;
+  return current;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cGuideGrid::Put(cGridSnapshot* snapshot)
+{
+  if (!snapshot)
+    return;
+    
+  bool last;
+  {
+    cMutexLock lock(&mutex);
+    last = (--snapshot->refs == 0);
+  }
+  if (last)
+    delete snapshot;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2006-2010 Alex Lasnier <alex@fepg.org>
+ *
+ * This file is part of ATSC EPG
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __ATSC_GUIDE_GRID_H
+#define __ATSC_GUIDE_GRID_H
+
+#include <vector>
+#include <string>
+
+#include <vdr/channels.h>
+#include <vdr/thread.h>
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+// An immutable copy of the guide, indexed by time bucket and channel. Cells 
+// list the events overlapping a bucket, so a slice costs the same no matter 
+// how large the guide is. Obtained from cGuideGrid::Get() and handed back 
+// with cGuideGrid::Put().
+class cGridSnapshot
+{
+public:
+  struct Channel {
+    tChannelID channelID;
+    uint16_t majorNumber;
+    uint16_t minorNumber;
+  };
+  
+  struct Event {
+    uint32_t channel; // Index into Channels()
+    uint32_t title;   // Index for Title()
+    time_t startTime;
+    int duration;
+    uint16_t eventId;
+  };
+  
+  time_t Start(void) const { return start; }
+  time_t End(void) const { return start + (time_t) numBuckets * bucketSeconds; }
+  const std::vector<Channel>& Channels(void) const { return channels; }
+  const std::string& Title(const Event& event) const { return titles[event.title]; }
+  
+  // Events overlapping [from, to) by channel order, then start time
+  int Slice(time_t from, time_t to, std::vector<const Event*>& result) const;
+  
+private:
+  friend class cGuideGrid;
+  cGridSnapshot(void) : refs(1), start(0), numBuckets(0), bucketSeconds(1) {}
+  
+  int refs; // Guarded by cGuideGrid
+  time_t start;
+  int numBuckets;
+  int bucketSeconds;
+  
+  std::vector<Channel> channels;  // Sorted by major/minor number
+  std::vector<Event> events;      // Sorted by channel, then start time
+  std::vector<std::string> titles;
+  std::vector<uint32_t> cellStart; // (bucket * channels + channel), one extra at the end
+  std::vector<uint32_t> cells;     // Indices into events
+};
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+// Keeps the current grid snapshot. Rebuilt from the guide store after 
+// acquisitions and during housekeeping, readers only hold a lock long 
+// enough to take a reference.
+class cGuideGrid
+{
+public:
+  cGuideGrid(void);
+  ~cGuideGrid();
+  
+  void Update(bool force = false);
+  void Invalidate(void) { dirty = true; } // Rebuilt by the next housekeeping
+  bool Dirty(void) const { return dirty; }
+  cGridSnapshot* Get(void);
+  void Put(cGridSnapshot* snapshot);
+  
+private:
+  static bool ChannelBefore(const cGridSnapshot::Channel& a, const cGridSnapshot::Channel& b);
+  static bool EventBefore(const cGridSnapshot::Event& a, const cGridSnapshot::Event& b);
+  
+  cGridSnapshot* current;
+  uint32_t generation;
+  volatile bool dirty;
+  cMutex mutex;       // Guards current and the reference counts
+  cMutex buildMutex;  // Serializes Update()
+};
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+extern cGuideGrid GuideGrid;
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+#endif //__ATSC_GUIDE_GRID_H
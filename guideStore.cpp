@@ -0,0 +1,905 @@
+/*
+ * Copyright (C) 2006-2010 Alex Lasnier <alex@fepg.org>
+ *
+ * This file is part of ATSC EPG
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <iterator>
+
+#include <vdr/sources.h>
+
+#include "guideStore.h"
+#include "descriptors.h"
+#include "vdrInterface.h"
+#include "stats.h"
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+#define TOMBSTONE     0xFFFFFFFF
+#define NO_SOURCE     0xFFFF
+#define NO_CHANNEL    0xFFFFFFFF
+#define MIN_BUCKETS   64
+#define MIN_GARBAGE   (64 * 1024) // Bytes of dead strings before compacting
+
+cGuideStore GuideStore;
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+cStringPool::cStringPool(void)
+{
+  Clear();
+}
+
+
+//----------------------------------------------------------------------------
+
+void cStringPool::Clear(void)
+{
+  Entry empty = { 0, 0, 0, 0 };
+  
+  blob.assign(1, '\0');
+  entries.assign(1, empty);
+  buckets.assign(MIN_BUCKETS, 0);
+  freeIds.clear();
+  garbage = 0;
+  numLive = 0;
+  numUsedBuckets = 0;
+}
+
+
+//----------------------------------------------------------------------------
+
+uint32_t cStringPool::Hash(const char* data, size_t length)
+{
+  // FNV-1a
+  uint32_t h = 2166136261u;
+  for (size_t i=0; i<length; i++) {
+    h ^= (uint8_t) data[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+
+//----------------------------------------------------------------------------
+
+uint32_t cStringPool::Intern(const char* data, size_t length)
+{
+  if (!data || !length)
+    return 0;
+    
+  if (2 * (numUsedBuckets + 1) > (int) buckets.size())
+    Rehash(std::max((size_t) MIN_BUCKETS, buckets.size() * (4 * numLive > (int) buckets.size() ? 2 : 1)));
+    
+  uint32_t h = Hash(data, length);
+  size_t mask = buckets.size() - 1;
+  int tomb = -1;
+  size_t i;
+  
+  for (i = h & mask; buckets[i]; i = (i + 1) & mask)
+  {
+    uint32_t id = buckets[i];
+    if (id == TOMBSTONE) {
+      if (tomb < 0)
+        tomb = i;
+      continue;
+    }
+    Entry& e = entries[id];
+    if (e.hash == h && e.length == length && memcmp(&blob[e.offset], data, length) == 0) {
+      e.refs++;
+      return id;
+    }
+  }
+  
+  uint32_t id;
+  if (freeIds.empty()) {
+    id = entries.size();
+    entries.push_back(Entry());
+  }
+  else {
+    id = freeIds.back();
+    freeIds.pop_back();
+  }
+  
+  Entry& e = entries[id];
+  e.offset = blob.size();
+  e.length = length;
+  e.refs = 1;
+  e.hash = h;
+  blob.insert(blob.end(), data, data + length);
+  blob.push_back('\0');
+  
+  if (tomb >= 0)
+    buckets[tomb] = id;
+  else {
+    buckets[i] = id;
+    numUsedBuckets++;
+  }
+  numLive++;
+  
+  return id;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cStringPool::Release(uint32_t id)
+{
+  if (!id || id >= entries.size() || !entries[id].refs)
+    return;
+    
+  Entry& e = entries[id];
+  if (--e.refs)
+    return;
+    
+  size_t mask = buckets.size() - 1;
+  for (size_t i = e.hash & mask; buckets[i]; i = (i + 1) & mask) {
+    if (buckets[i] == id) {
+      buckets[i] = TOMBSTONE;
+      break;
+    }
+  }
+  
+  garbage += e.length + 1;
+  freeIds.push_back(id);
+  numLive--;
+  
+  if (garbage > MIN_GARBAGE && 2 * garbage > blob.size())
+    Compact();
+}
+
+
+//----------------------------------------------------------------------------
+
+void cStringPool::Insert(uint32_t id)
+{
+  size_t mask = buckets.size() - 1;
+  size_t i = entries[id].hash & mask;
+  while (buckets[i])
+    i = (i + 1) & mask;
+  buckets[i] = id;
+  numUsedBuckets++;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cStringPool::Rehash(size_t size)
+{
+  buckets.assign(size, 0);
+  numUsedBuckets = 0;
+  
+  for (uint32_t id=1; id<entries.size(); id++)
+    if (entries[id].refs)
+      Insert(id);
+}
+
+
+//----------------------------------------------------------------------------
+
+void cStringPool::Compact(void)
+{
+  // Ids stay the same, only the strings move
+  std::vector<char> compacted;
+  compacted.reserve(blob.size() - garbage);
+  compacted.push_back('\0');
+  
+  for (uint32_t id=1; id<entries.size(); id++)
+  {
+    Entry& e = entries[id];
+    if (!e.refs)
+      continue;
+    uint32_t offset = compacted.size();
+    compacted.insert(compacted.end(), blob.begin() + e.offset, blob.begin() + e.offset + e.length + 1);
+    e.offset = offset;
+  }
+  
+  blob.swap(compacted);
+  garbage = 0;
+}
+
+
+//----------------------------------------------------------------------------
+
+size_t cStringPool::Bytes(void) const
+{
+  return blob.capacity() + entries.capacity() * sizeof(Entry) + 
+         buckets.capacity() * sizeof(uint32_t) + freeIds.capacity() * sizeof(uint32_t);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+cGuideStore::cGuideStore(void)
+{
+  numUsedBuckets = 0;
+  numEvents = 0;
+  generation = 0;
+  index.assign(MIN_BUCKETS, 0);
+}
+
+
+//----------------------------------------------------------------------------
+
+int cGuideStore::GetSource(int transponder, uint16_t sourceId, bool create)
+{
+  uint64_t key = ((uint64_t) (uint32_t) transponder << 16) | sourceId;
+  
+  std::map<uint64_t, uint16_t>::const_iterator itr = sourceIndex.find(key);
+  if (itr != sourceIndex.end())
+    return itr->second;
+    
+  if (!create || sources.size() >= NO_SOURCE)
+    return -1;
+    
+  Source s;
+  s.transponder = transponder;
+  s.sourceId = sourceId;
+  s.tsid = 0;
+  s.pmtSid = 0;
+  s.majorNumber = 0;
+  s.minorNumber = 0;
+  sources.push_back(s);
+  
+  sourceIndex[key] = sources.size() - 1;
+  return sources.size() - 1;
+}
+
+
+//----------------------------------------------------------------------------
+
+int cGuideStore::FindSlot(int src, uint16_t id) const
+{
+  size_t mask = index.size() - 1;
+  for (size_t i = SlotHash(src, id) & mask; index[i]; i = (i + 1) & mask)
+  {
+    if (index[i] == TOMBSTONE)
+      continue;
+    int slot = index[i] - 1;
+    if (source[slot] == src && eventId[slot] == id)
+      return slot;
+  }
+  
+  return -1;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cGuideStore::IndexInsert(int slot)
+{
+  if (2 * (numUsedBuckets + 1) > (int) index.size())
+    Reindex(std::max((size_t) MIN_BUCKETS, index.size() * (4 * numEvents > (int) index.size() ? 2 : 1)));
+    
+  size_t mask = index.size() - 1;
+  size_t i = SlotHash(source[slot], eventId[slot]) & mask;
+  while (index[i] && index[i] != TOMBSTONE)
+    i = (i + 1) & mask;
+    
+  if (!index[i])
+    numUsedBuckets++;
+  index[i] = slot + 1;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cGuideStore::IndexRemove(int slot)
+{
+  size_t mask = index.size() - 1;
+  for (size_t i = SlotHash(source[slot], eventId[slot]) & mask; index[i]; i = (i + 1) & mask) {
+    if (index[i] == (uint32_t) slot + 1) {
+      index[i] = TOMBSTONE;
+      return;
+    }
+  }
+}
+
+
+//----------------------------------------------------------------------------
+
+void cGuideStore::Reindex(size_t size)
+{
+  index.assign(size, 0);
+  numUsedBuckets = 0;
+  
+  size_t mask = size - 1;
+  for (size_t slot=0; slot<source.size(); slot++) 
+  {
+    if (source[slot] == NO_SOURCE)
+      continue;
+    size_t i = SlotHash(source[slot], eventId[slot]) & mask;
+    while (index[i])
+      i = (i + 1) & mask;
+    index[i] = slot + 1;
+    numUsedBuckets++;
+  }
+}
+
+
+//----------------------------------------------------------------------------
+
+int cGuideStore::NewSlot(void)
+{
+  if (!freeSlots.empty()) {
+    int slot = freeSlots.back();
+    freeSlots.pop_back();
+    return slot;
+  }
+  
+  startTime.push_back(0);
+  duration.push_back(0);
+  title.push_back(0);
+  text.push_back(0);
+  eventId.push_back(0);
+  source.push_back(NO_SOURCE);
+  version.push_back(0);
+  tableId.push_back(0);
+  etmLocation.push_back(0);
+  attributes.push_back(EventAttributes());
+  
+  return source.size() - 1;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cGuideStore::FreeSlot(int slot)
+{
+  IndexRemove(slot);
+  Release(title[slot], false, slot);
+  Release(text[slot], true, slot);
+  title[slot] = 0;
+  text[slot] = 0;
+  source[slot] = NO_SOURCE;
+  freeSlots.push_back(slot);
+  numEvents--;
+  generation++;
+}
+
+
+//----------------------------------------------------------------------------
+
+// Texts are decoded for the index later by IndexTexts(), not on the 
+// section handler's time
+uint32_t cGuideStore::Intern(const char* data, size_t length, bool raw, int slot)
+{
+  uint32_t id = strings.Intern(data, length);
+  if (!id)
+    return 0;
+    
+  if (strings.Refs(id) == 1) { // New string
+    if (raw)
+      unindexed.insert(id);
+    else
+      searchIndex.Add(id, StringText(id, false));
+  }
+  
+  if (id >= users.size())
+    users.resize(id + 1);
+  users[id].push_back(slot);
+  return id;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cGuideStore::Release(uint32_t id, bool raw, int slot)
+{
+  if (!id)
+    return;
+    
+  if (id < users.size()) {
+    std::vector<uint32_t>& u = users[id];
+    std::vector<uint32_t>::iterator itr = std::find(u.begin(), u.end(), (uint32_t) slot);
+    if (itr != u.end()) {
+      *itr = u.back();
+      u.pop_back();
+    }
+    if (u.empty())
+      std::vector<uint32_t>().swap(u);
+  }
+  
+  if (strings.Refs(id) == 1 && !(raw && unindexed.erase(id))) // Last reference
+    searchIndex.Remove(id, StringText(id, raw));
+  strings.Release(id);
+}
+
+
+//----------------------------------------------------------------------------
+
+// Indexes up to count texts, returns whether any are left. The lock is only
+// held for one chunk so the section handlers can get in between.
+bool cGuideStore::IndexTexts(int count)
+{
+  cMutexLock lock(&mutex);
+  
+  for (; count > 0 && !unindexed.empty(); count--) {
+    uint32_t id = *unindexed.begin();
+    unindexed.erase(unindexed.begin());
+    searchIndex.Add(id, StringText(id, true));
+  }
+  
+  return !unindexed.empty();
+}
+
+
+//----------------------------------------------------------------------------
+
+std::string cGuideStore::StringText(uint32_t id, bool raw) const
+{
+  if (!raw)
+    return std::string(strings.Data(id), strings.Length(id));
+    
+  return MultipleStringStructure::FirstString((const u8*) strings.Data(id), strings.Length(id));
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cGuideStore::AddEvent(int transponder, uint16_t sourceId, const Event& event)
+{
+  cMutexLock lock(&mutex);
+  
+  int src = GetSource(transponder, sourceId, true);
+  if (src < 0)
+    return false;
+    
+  int slot = FindSlot(src, event.event_id);
+  if (slot >= 0) 
+  {
+    if (version[slot] == event.version_number && startTime[slot] == event.start_time)
+      return false;
+  }
+  else
+  {
+    slot = NewSlot();
+    source[slot] = src;
+    eventId[slot] = event.event_id;
+    IndexInsert(slot);
+    numEvents++;
+  }
+  
+  const char* t = event.TitleText();
+  uint32_t oldTitle = title[slot];
+  title[slot] = Intern(t, t ? strlen(t) : 0, false, slot);
+  Release(oldTitle, false, slot);
+  
+  startTime[slot] = event.start_time;
+  duration[slot] = event.length_in_seconds;
+  version[slot] = event.version_number;
+  tableId[slot] = event.table_id;
+  etmLocation[slot] = event.ETM_location;
+  attributes[slot] = event.attributes;
+  generation++;
+  
+  return true;
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cGuideStore::SetText(int transponder, uint16_t sourceId, uint16_t id, const char* data, int length)
+{
+  // Also loaded from the cache files, the text must not be decoded past its end
+  if (!MultipleStringStructure::IsValid((const u8*) data, length))
+    return false;
+    
+  cMutexLock lock(&mutex);
+  
+  int src = GetSource(transponder, sourceId, false);
+  int slot = (src >= 0) ? FindSlot(src, id) : -1;
+  if (slot < 0)
+    return false;
+    
+  uint32_t oldText = text[slot];
+  if (oldText && strings.Length(oldText) == (size_t) length && memcmp(strings.Data(oldText), data, length) == 0)
+    return false;
+    
+  text[slot] = Intern(data, length, true, slot);
+  Release(oldText, true, slot);
+  generation++;
+  
+  return true;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cGuideStore::SetChannels(int transponder, const ChannelMap& channelMap)
+{
+  cMutexLock lock(&mutex);
+  
+  for (unsigned int i=0; i<channelMap.channels.size(); i++)
+  {
+    const ChannelMap::Entry& e = channelMap.channels[i];
+    int src = GetSource(transponder, e.sourceId, true);
+    if (src < 0)
+      continue;
+      
+    Source& s = sources[src];
+    std::map<uint32_t, uint16_t>::iterator old = channelIndex.find(((uint32_t) s.tsid << 16) | s.pmtSid);
+    if (old != channelIndex.end() && old->second == src)
+      channelIndex.erase(old);
+    s.tsid = channelMap.tsid;
+    s.pmtSid = e.programNumber;
+    s.majorNumber = e.majorNumber;
+    s.minorNumber = e.minorNumber;
+    channelIndex[((uint32_t) s.tsid << 16) | s.pmtSid] = src;
+  }
+  
+  generation++;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cGuideStore::ClearTransponder(int transponder)
+{
+  cMutexLock lock(&mutex);
+  
+  for (size_t slot=0; slot<source.size(); slot++)
+    if (source[slot] != NO_SOURCE && sources[source[slot]].transponder == transponder)
+      FreeSlot(slot);
+}
+
+
+//----------------------------------------------------------------------------
+
+void cGuideStore::Clear(void)
+{
+  cMutexLock lock(&mutex);
+  
+  startTime.clear();
+  duration.clear();
+  title.clear();
+  text.clear();
+  eventId.clear();
+  source.clear();
+  version.clear();
+  tableId.clear();
+  etmLocation.clear();
+  attributes.clear();
+  
+  freeSlots.clear();
+  index.assign(MIN_BUCKETS, 0);
+  numUsedBuckets = 0;
+  numEvents = 0;
+  
+  sources.clear();
+  sourceIndex.clear();
+  channelIndex.clear();
+  strings.Clear();
+  searchIndex.Clear();
+  unindexed.clear();
+  users.clear();
+  generation++;
+}
+
+
+//----------------------------------------------------------------------------
+
+int cGuideStore::DropEnded(time_t now)
+{
+  cMutexLock lock(&mutex);
+  
+  int dropped = 0;
+  for (size_t slot=0; slot<source.size(); slot++) 
+  {
+    if (source[slot] == NO_SOURCE)
+      continue;
+    if (VDRInterface::GPStoLocal(startTime[slot]) + (time_t) duration[slot] < now) {
+      FreeSlot(slot);
+      dropped++;
+    }
+  }
+  
+  UpdateStats();
+  return dropped;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cGuideStore::UpdateStats(void)
+{
+  size_t bytes = source.capacity() * (4 * sizeof(uint32_t) + 2 * sizeof(uint16_t) + 3 * sizeof(uint8_t) + sizeof(EventAttributes)) +
+                 (freeSlots.capacity() + index.capacity()) * sizeof(uint32_t) +
+                 sources.capacity() * sizeof(Source) + strings.Bytes() +
+                 users.capacity() * sizeof(std::vector<uint32_t>) + 2 * numEvents * sizeof(uint32_t);
+                 
+  Stats.Set(S_GUIDE_EVENTS, numEvents);
+  Stats.Set(S_GUIDE_STRINGS, strings.Count());
+  Stats.Set(S_GUIDE_BYTES, bytes);
+  Stats.Set(S_SEARCH_WORDS, searchIndex.Words());
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cGuideStore::EntryBefore(const Entry& a, const Entry& b)
+{
+  if (a.sourceId != b.sourceId)
+    return a.sourceId < b.sourceId;
+  return a.event.start_time < b.event.start_time;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cGuideStore::GetEvents(int transponder, std::vector<Entry>& entries)
+{
+  cMutexLock lock(&mutex);
+  
+  entries.clear();
+  for (size_t slot=0; slot<source.size(); slot++)
+  {
+    if (source[slot] == NO_SOURCE || sources[source[slot]].transponder != transponder)
+      continue;
+      
+    entries.push_back(Entry());
+    Entry& e = entries.back();
+    e.sourceId = sources[source[slot]].sourceId;
+    e.event.event_id = eventId[slot];
+    e.event.start_time = startTime[slot];
+    e.event.length_in_seconds = duration[slot];
+    e.event.version_number = version[slot];
+    e.event.table_id = tableId[slot];
+    e.event.ETM_location = etmLocation[slot];
+    e.event.attributes = attributes[slot];
+    e.event.SetTitleText(strings.Data(title[slot]));
+    e.text.assign(strings.Data(text[slot]), strings.Length(text[slot]));
+  }
+  
+  std::sort(entries.begin(), entries.end(), EntryBefore);
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cGuideStore::GetDescription(const tChannelID& channelID, uint16_t id, std::string& description)
+{
+  cMutexLock lock(&mutex);
+  
+  std::map<uint32_t, uint16_t>::const_iterator itr = channelIndex.find(((uint32_t) (channelID.Tid() & 0xFFFF) << 16) | (channelID.Sid() & 0xFFFF));
+  if (itr == channelIndex.end())
+    return false;
+    
+  int slot = FindSlot(itr->second, id);
+  if (slot < 0 || !text[slot])
+    return false;
+    
+  description = StringText(text[slot], true);
+  return true;
+}
+
+
+//----------------------------------------------------------------------------
+
+// The sorted slots of the events using any of the strings
+void cGuideStore::SlotsOf(const std::vector<uint32_t>& ids, std::vector<uint32_t>& slots) const
+{
+  slots.clear();
+  for (unsigned int i=0; i<ids.size(); i++)
+    if (ids[i] < users.size())
+      slots.insert(slots.end(), users[ids[i]].begin(), users[ids[i]].end());
+      
+  std::sort(slots.begin(), slots.end());
+  slots.erase(std::unique(slots.begin(), slots.end()), slots.end());
+}
+
+
+//----------------------------------------------------------------------------
+
+// Events with the word in their title or their description
+void cGuideStore::FindWord(const SearchQuery::Term& term, std::vector<uint32_t>& slots) const
+{
+  std::vector<uint32_t> ids;
+  searchIndex.Find(term, ids);
+  SlotsOf(ids, slots);
+}
+
+
+//----------------------------------------------------------------------------
+
+// Events with the words next to each other in their title or their 
+// description. Only the strings containing all the words are tokenized.
+void cGuideStore::FindPhrase(const std::vector<std::string>& phrase, std::vector<uint32_t>& slots) const
+{
+  std::vector<uint32_t> ids, wordIds, both;
+  for (unsigned int i=0; i<phrase.size(); i++)
+  {
+    SearchQuery::Term t = { phrase[i], false };
+    searchIndex.Find(t, wordIds);
+    if (i == 0)
+      ids.swap(wordIds);
+    else {
+      both.clear();
+      std::set_intersection(ids.begin(), ids.end(), wordIds.begin(), wordIds.end(), std::back_inserter(both));
+      ids.swap(both);
+    }
+  }
+  
+  std::vector<uint32_t> matching;
+  std::vector<std::string> words;
+  for (unsigned int i=0; i<ids.size(); i++)
+  {
+    if (ids[i] >= users.size() || users[ids[i]].empty())
+      continue;
+    bool raw = text[users[ids[i]][0]] == ids[i];
+    cSearchIndex::Tokenize(StringText(ids[i], raw), words);
+    if (cSearchIndex::ContainsPhrase(words, phrase))
+      matching.push_back(ids[i]);
+  }
+  
+  SlotsOf(matching, slots);
+}
+
+
+//----------------------------------------------------------------------------
+
+// All words must be in the title or the description of an event, but not 
+// necessarily in the same one. Only the events using matching strings are 
+// visited.
+int cGuideStore::Search(const char* query, unsigned int maxResults, std::vector<SearchResult>& results)
+{
+  results.clear();
+  
+  SearchQuery q;
+  if (!q.Parse(query))
+    return -1;
+    
+  cMutexLock lock(&mutex);
+  
+  std::vector<uint32_t> slots, found, both;
+  for (unsigned int i=0; i<q.terms.size() + q.phrases.size(); i++)
+  {
+    if (i < q.terms.size())
+      FindWord(q.terms[i], found);
+    else
+      FindPhrase(q.phrases[i - q.terms.size()], found);
+      
+    if (i == 0)
+      slots.swap(found);
+    else {
+      both.clear();
+      std::set_intersection(slots.begin(), slots.end(), found.begin(), found.end(), std::back_inserter(both));
+      slots.swap(both);
+    }
+    
+    if (slots.empty())
+      return 0;
+  }
+  
+  // Earliest first, only the events returned are copied
+  std::vector<std::pair<uint32_t, uint32_t> > byStart; // Start time, slot
+  for (unsigned int i=0; i<slots.size(); i++) {
+    const Source& src = sources[source[slots[i]]];
+    if (src.tsid || src.pmtSid) // Has a channel map
+      byStart.push_back(std::make_pair(startTime[slots[i]], slots[i]));
+  }
+  
+  if (byStart.size() > maxResults) {
+    std::nth_element(byStart.begin(), byStart.begin() + maxResults, byStart.end());
+    byStart.resize(maxResults);
+  }
+  std::sort(byStart.begin(), byStart.end());
+  
+  for (unsigned int i=0; i<byStart.size(); i++)
+  {
+    uint32_t slot = byStart[i].second;
+    const Source& src = sources[source[slot]];
+    
+    SearchResult r;
+    r.channelID = tChannelID(cSource::stAtsc, 0, src.tsid, src.pmtSid);
+    r.eventId = eventId[slot];
+    r.startTime = VDRInterface::GPStoLocal(startTime[slot]);
+    r.duration = duration[slot];
+    r.title = strings.Data(title[slot]);
+    results.push_back(r);
+  }
+    
+  return results.size();
+}
+
+
+//----------------------------------------------------------------------------
+
+void cGuideStore::GetWindow(time_t from, time_t to, std::vector<WindowChannel>& channels, std::vector<WindowEvent>& events, std::vector<std::string>& stringList, bool withTexts)
+{
+  cMutexLock lock(&mutex);
+  
+  channels.clear();
+  events.clear();
+  stringList.clear();
+  
+  std::vector<uint32_t> channelOf(sources.size(), NO_CHANNEL);
+  std::map<uint32_t, uint32_t> titleOf, textOf;
+  
+  for (size_t slot=0; slot<source.size(); slot++)
+  {
+    if (source[slot] == NO_SOURCE)
+      continue;
+      
+    const Source& src = sources[source[slot]];
+    if (!src.tsid && !src.pmtSid)
+      continue; // No channel map yet
+      
+    time_t start = VDRInterface::GPStoLocal(startTime[slot]);
+    if (start >= to || start + (time_t) duration[slot] <= from)
+      continue;
+      
+    uint32_t& c = channelOf[source[slot]];
+    if (c == NO_CHANNEL) {
+      WindowChannel wc;
+      wc.channelID = tChannelID(cSource::stAtsc, 0, src.tsid, src.pmtSid);
+      wc.majorNumber = src.majorNumber;
+      wc.minorNumber = src.minorNumber;
+      c = channels.size();
+      channels.push_back(wc);
+    }
+    
+    std::map<uint32_t, uint32_t>::iterator t = titleOf.find(title[slot]);
+    if (t == titleOf.end()) {
+      t = titleOf.insert(std::make_pair(title[slot], (uint32_t) stringList.size())).first;
+      stringList.push_back(StringText(title[slot], false));
+    }
+    
+    WindowEvent e;
+    e.channel = c;
+    e.title = t->second;
+    e.text = NO_TEXT;
+    if (withTexts && text[slot]) {
+      std::map<uint32_t, uint32_t>::iterator d = textOf.find(text[slot]);
+      if (d == textOf.end()) {
+        d = textOf.insert(std::make_pair(text[slot], (uint32_t) stringList.size())).first;
+        stringList.push_back(StringText(text[slot], true));
+      }
+      e.text = d->second;
+    }
+    e.startTime = start;
+    e.duration = duration[slot];
+    e.eventId = eventId[slot];
+    events.push_back(e);
+  }
+}
+
+
+//----------------------------------------------------------------------------
+
+int cGuideStore::Count(void)
+{
+  cMutexLock lock(&mutex);
+  return numEvents;
+}
+
+
+//----------------------------------------------------------------------------
+
+uint32_t cGuideStore::Generation(void)
+{
+  cMutexLock lock(&mutex);
+  return generation;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
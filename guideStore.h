@@ -0,0 +1,203 @@
+/*
+ * Copyright (C) 2006-2010 Alex Lasnier <alex@fepg.org>
+ *
+ * This file is part of ATSC EPG
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __ATSC_GUIDE_STORE_H
+#define __ATSC_GUIDE_STORE_H
+
+#include <map>
+#include <set>
+#include <vector>
+#include <string>
+
+#include <vdr/channels.h>
+#include <vdr/thread.h>
+
+#include "structs.h"
+#include "searchIndex.h"
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+// Reference counted, deduplicated strings addressed by 32-bit ids. All
+// strings share one buffer. Id 0 is the empty string.
+class cStringPool
+{
+public:
+  cStringPool(void);
+  
+  uint32_t Intern(const char* data, size_t length);
+  void Release(uint32_t id);
+  void Clear(void);
+  
+  const char* Data(uint32_t id) const { return &blob[entries[id].offset]; }
+  size_t Length(uint32_t id) const { return entries[id].length; }
+  uint32_t Refs(uint32_t id) const { return entries[id].refs; }
+  int Count(void) const { return numLive; }
+  size_t Bytes(void) const;
+  
+private:
+  struct Entry {
+    uint32_t offset;
+    uint32_t length;
+    uint32_t refs;
+    uint32_t hash;
+  };
+  
+  static uint32_t Hash(const char* data, size_t length);
+  void Insert(uint32_t id);
+  void Rehash(size_t size);
+  void Compact(void);
+  
+  std::vector<char> blob;
+  std::vector<Entry> entries;
+  std::vector<uint32_t> buckets; // Open addressing, holds ids
+  std::vector<uint32_t> freeIds;
+  size_t garbage;
+  int numLive;
+  int numUsedBuckets;
+};
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+// The plugin's own copy of the guide. Events are kept in parallel arrays 
+// (one per field) with titles and raw ETT texts interned in a string pool,
+// so scanning the guide touches little memory and repeated strings are only
+// stored once.
+class cGuideStore
+{
+public:
+  struct Entry {
+    uint16_t sourceId;
+    Event event;
+    std::string text; // Raw multiple string structure
+  };
+  
+  struct SearchResult {
+    tChannelID channelID;
+    uint16_t eventId;
+    time_t startTime;
+    int duration;
+    std::string title;
+  };
+  
+  // Channels and strings are indices into the vectors filled alongside
+  struct WindowChannel {
+    tChannelID channelID;
+    uint16_t majorNumber;
+    uint16_t minorNumber;
+  };
+  
+  struct WindowEvent {
+    uint32_t channel;
+    uint32_t title;
+    uint32_t text;    // NO_TEXT unless asked for
+    time_t startTime; // Local
+    int duration;
+    uint16_t eventId;
+  };
+  
+  cGuideStore(void);
+  
+  bool AddEvent(int transponder, uint16_t sourceId, const Event& event);
+  bool SetText(int transponder, uint16_t sourceId, uint16_t eventId, const char* text, int length);
+  void SetChannels(int transponder, const ChannelMap& channelMap);
+  void ClearTransponder(int transponder);
+  void Clear(void);
+  int  DropEnded(time_t now);
+  
+  void GetEvents(int transponder, std::vector<Entry>& entries);
+  bool GetDescription(const tChannelID& channelID, uint16_t eventId, std::string& description);
+  int  Search(const char* query, unsigned int maxResults, std::vector<SearchResult>& results);
+  bool IndexTexts(int count);
+  enum { NO_TEXT = 0xFFFFFFFF };
+  
+  void GetWindow(time_t from, time_t to, std::vector<WindowChannel>& channels, std::vector<WindowEvent>& events, std::vector<std::string>& stringList, bool withTexts = false);
+  int  Count(void);
+  uint32_t Generation(void);
+  
+private:
+  struct Source {
+    int transponder;
+    uint16_t sourceId;
+    uint16_t tsid;
+    uint16_t pmtSid;
+    uint16_t majorNumber;
+    uint16_t minorNumber;
+  };
+  
+  int GetSource(int transponder, uint16_t sourceId, bool create);
+  int FindSlot(int src, uint16_t eventId) const;
+  int NewSlot(void);
+  void FreeSlot(int slot);
+  void IndexInsert(int slot);
+  void IndexRemove(int slot);
+  void Reindex(size_t size);
+  void UpdateStats(void);
+  uint32_t Intern(const char* data, size_t length, bool raw, int slot);
+  void Release(uint32_t id, bool raw, int slot);
+  std::string StringText(uint32_t id, bool raw) const;
+  void SlotsOf(const std::vector<uint32_t>& ids, std::vector<uint32_t>& slots) const;
+  void FindWord(const SearchQuery::Term& term, std::vector<uint32_t>& slots) const;
+  void FindPhrase(const std::vector<std::string>& phrase, std::vector<uint32_t>& slots) const;
+  static uint32_t SlotHash(int src, uint16_t eventId) { return (((uint32_t) src << 16) | eventId) * 2654435761u; }
+  static bool EntryBefore(const Entry& a, const Entry& b);
+  
+  // One element per slot
+  std::vector<uint32_t> startTime; // GPS
+  std::vector<uint32_t> duration;
+  std::vector<uint32_t> title;     // String pool ids
+  std::vector<uint32_t> text;
+  std::vector<uint16_t> eventId;
+  std::vector<uint16_t> source;    // Index into sources, NO_SOURCE if free
+  std::vector<uint8_t>  version;
+  std::vector<uint8_t>  tableId;
+  std::vector<uint8_t>  etmLocation;
+  std::vector<EventAttributes> attributes;
+  
+  std::vector<uint32_t> freeSlots;
+  std::vector<uint32_t> index; // Open addressing, holds slot + 1
+  int numUsedBuckets;
+  int numEvents;
+  uint32_t generation; // Changes whenever events or channels do
+  
+  std::vector<Source> sources;
+  std::map<uint64_t, uint16_t> sourceIndex;  // Transponder << 16 | source id
+  std::map<uint32_t, uint16_t> channelIndex; // TSID << 16 | PMT SID
+  
+  cStringPool strings;
+  cSearchIndex searchIndex; // Over the strings, texts are indexed decoded
+  std::set<uint32_t> unindexed; // Texts not decoded yet, see IndexTexts()
+  std::vector<std::vector<uint32_t> > users; // Slots using each string, by string id
+  cMutex mutex;
+};
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+extern cGuideStore GuideStore;
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+#endif //__ATSC_GUIDE_STORE_H
@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) 2006-2010 Alex Lasnier <alex@fepg.org>
+ *
+ * This file is part of ATSC EPG
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <vdr/channels.h>
+
+#include "harvester.h"
+#include "devices.h"
+#include "filterManager.h"
+#include "config.h"
+#include "tools.h"
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+#define HARVEST_POLL     2000 // ms
+#define HARVEST_INTERVAL (3 * 3600) // Leave transponders acquired since alone
+#define SETTLE_TIME      20   // s, to lock and receive the VCT and MGT
+#define PSIP_RATE        6250 // Bytes/s of EIT/ETT, a conservative 50 kbit/s
+#define MAX_DWELL        600  // s
+
+cEpgHarvester Harvester;
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+cEpgHarvester::cEpgHarvester(void) : cThread("ATSC EPG harvester", true)
+{
+  for (int i=0; i<MAXDEVICES; i++) {
+    harvests[i].transponder = 0;
+    harvests[i].tuned = 0;
+    deviceTransponders[i] = 0;
+  }
+  switching = -1;
+}
+
+
+//----------------------------------------------------------------------------
+
+cEpgHarvester::~cEpgHarvester()
+{
+  Stop();
+}
+
+
+//----------------------------------------------------------------------------
+
+void cEpgHarvester::Stop(void)
+{
+  Cancel(-1);
+  wait.Signal();
+  Cancel(3);
+}
+
+
+//----------------------------------------------------------------------------
+
+void cEpgHarvester::ChannelSwitch(const cDevice* Device, int ChannelNumber)
+{
+  if (!ChannelNumber)
+    return;
+    
+  cMutexLock lock(&mutex);
+  for (int i=0; i<AtscDevices.NumDevices(); i++)
+  {
+    if (AtscDevices.GetDevice(i) != Device)
+      continue;
+      
+    const cChannel* channel = Channels.GetByNumber(ChannelNumber);
+    deviceTransponders[i] = channel ? channel->Transponder() : 0;
+    
+    if (i != switching) 
+    {
+      // VDR needs the device, yield it
+      if (harvests[i].transponder) {
+        dprint(L_DBG, "Harvester: device %d taken over by VDR.", i);
+        harvests[i].transponder = 0;
+      }
+      if (deviceTransponders[i])
+        views[deviceTransponders[i]]++;
+    }
+    break;
+  }
+}
+
+
+//----------------------------------------------------------------------------
+
+void cEpgHarvester::Action(void)
+{
+  while (Running())
+  {
+    wait.Wait(HARVEST_POLL);
+    if (!Running())
+      break;
+      
+    time_t now = time(NULL);
+    for (int i=0; i<AtscDevices.NumDevices() && i<MAXDEVICES; i++)
+      Check(i, now);
+  }
+}
+
+
+//----------------------------------------------------------------------------
+
+// Not recording, not streaming and not the device providing live TV
+bool cEpgHarvester::Idle(int device)
+{
+  cDevice* d = AtscDevices.GetDevice(device);
+  return d && !d->Receiving(true) && d != cDevice::ActualDevice() && !(d->IsPrimaryDevice() && d->HasDecoder());
+}
+
+
+//----------------------------------------------------------------------------
+
+void cEpgHarvester::Check(int device, time_t now)
+{
+  cMutexLock lock(&mutex);
+  Harvest& h = harvests[device];
+  
+  if (h.transponder) 
+  {
+    if (!Idle(device)) {
+      dprint(L_DBG, "Harvester: device %d is busy, yielding.", device);
+      h.transponder = 0;
+      return;
+    }
+    
+    // Stay only as long as the tables listed in the MGT should take
+    int bytes = FilterManager.PendingBytes(h.transponder);
+    int dwell = SETTLE_TIME + (bytes > 0 ? bytes / PSIP_RATE : 0);
+    
+    if (FilterManager.LastAcquired(h.transponder) >= h.tuned)
+      dprint(L_MSG, "Harvester: transponder %d acquired in %ds.", h.transponder, int(now - h.tuned));
+    else if (now - h.tuned >= min(dwell, MAX_DWELL))
+      dprint(L_MSG, "Harvester: giving up on transponder %d after %ds.", h.transponder, int(now - h.tuned));
+    else
+      return;
+      
+    h.transponder = 0;
+  }
+  
+  if (!config.harvest || !Idle(device))
+    return;
+    
+  if (!Channels.Lock(false, 100))
+    return;
+    
+  cDevice* d = AtscDevices.GetDevice(device);
+  if (const cChannel* channel = NextTransponder(d, now))
+  {
+    dprint(L_MSG, "Harvester: tuning device %d to transponder %d (%s).", device, channel->Transponder(), channel->Name());
+    switching = device;
+    if (d->SwitchChannel(channel, false)) {
+      h.transponder = channel->Transponder();
+      h.tuned = now;
+    }
+    switching = -1;
+  }
+  
+  Channels.Unlock();
+}
+
+
+//----------------------------------------------------------------------------
+
+// The most out of date transponder not tuned by any device, weighted by how
+// often it is watched. Channels must be locked.
+const cChannel* cEpgHarvester::NextTransponder(const cDevice* device, time_t now)
+{
+  const cChannel* best = NULL;
+  double bestScore = 0;
+  std::map<int, bool> seen;
+  
+  for (int i=0; i<AtscDevices.NumDevices() && i<MAXDEVICES; i++) 
+    seen[deviceTransponders[i]] = true;
+  
+  for (const cChannel* c = Channels.First(); c; c = Channels.Next(c))
+  {
+    if (c->GroupSep() || !c->IsAtsc() || seen[c->Transponder()])
+      continue;
+    seen[c->Transponder()] = true;
+    
+    time_t age = now - FilterManager.LastAcquired(c->Transponder());
+    if (age < HARVEST_INTERVAL || !device->ProvidesTransponder(c))
+      continue;
+      
+    std::map<int, int>::const_iterator v = views.find(c->Transponder());
+    double score = double(age) * (1 + (v != views.end() ? v->second : 0));
+    if (score > bestScore) {
+      bestScore = score;
+      best = c;
+    }
+  }
+  
+  return best;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2006-2010 Alex Lasnier <alex@fepg.org>
+ *
+ * This file is part of ATSC EPG
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __ATSC_HARVESTER_H
+#define __ATSC_HARVESTER_H
+
+#include <map>
+
+#include <vdr/device.h>
+#include <vdr/status.h>
+#include <vdr/thread.h>
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+// Tunes ATSC devices that are not recording or showing live TV to the 
+// transponders whose guide is the most out of date, so channels that nobody
+// watches get a guide as well. A device is given up as soon as VDR switches 
+// it to another channel or starts receiving with it.
+class cEpgHarvester : public cThread, public cStatus
+{
+public:
+  cEpgHarvester(void);
+  virtual ~cEpgHarvester();
+  
+  void Stop(void);
+  
+protected:
+  virtual void Action(void);
+  virtual void ChannelSwitch(const cDevice* Device, int ChannelNumber);
+  
+private:
+  struct Harvest {
+    int transponder; // 0 if the device is not harvesting
+    time_t tuned;
+  };
+  
+  bool Idle(int device);
+  void Check(int device, time_t now);
+  const cChannel* NextTransponder(const cDevice* device, time_t now);
+  
+  Harvest harvests[MAXDEVICES];
+  int deviceTransponders[MAXDEVICES]; // As last switched to
+  int switching; // Device the harvester is switching, -1 if none
+  std::map<int, int> views; // Transponder -> times switched to
+  
+  cMutex mutex;
+  cCondWait wait;
+};
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+extern cEpgHarvester Harvester;
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+#endif //__ATSC_HARVESTER_H
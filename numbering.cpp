@@ -0,0 +1,445 @@
+/*
+ * Copyright (C) 2006-2010 Alex Lasnier <alex@fepg.org>
+ *
+ * This file is part of ATSC EPG
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "numbering.h"
+#include "tools.h"
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+#define CONF_NAME        "numbering.conf"
+#define SCRIPT_NAME      "number"
+#define COPROCESS_TIMEOUT 2000 // ms
+#define MAX_ANSWER       1024 // Bytes before the co-process is taken as broken
+
+cChannelNumbering ChannelNumbering;
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+// Recursive descent over + - * / %, parentheses, integers and the variables
+// "major" and "minor".
+class cExpression
+{
+public:
+  cExpression(const char* Text, int Major, int Minor) : s(Text), major(Major), minor(Minor), ok(true) {}
+  
+  bool Evaluate(int& value) 
+  {
+    value = Sum();
+    Skip();
+    return ok && *s == 0;
+  }
+  
+private:
+  void Skip(void) { while (isspace(*s)) s++; }
+  
+  int Sum(void)
+  {
+    int v = Product();
+    for (;;) {
+      Skip();
+      if (*s == '+') { s++; v += Product(); }
+      else if (*s == '-') { s++; v -= Product(); }
+      else return v;
+    }
+  }
+  
+  int Product(void)
+  {
+    int v = Factor();
+    for (;;) {
+      Skip();
+      char op = *s;
+      if (op != '*' && op != '/' && op != '%')
+        return v;
+      s++;
+      int r = Factor();
+      if (op == '*')
+        v *= r;
+      else if (r == 0)
+        ok = false;
+      else
+        v = (op == '/') ? v / r : v % r;
+    }
+  }
+  
+  int Factor(void)
+  {
+    Skip();
+    if (*s == '-') { s++; return -Factor(); }
+    if (*s == '(') {
+      s++;
+      int v = Sum();
+      Skip();
+      if (*s == ')') s++; else ok = false;
+      return v;
+    }
+    if (isdigit(*s)) {
+      char* end;
+      int v = strtol(s, &end, 10);
+      s = end;
+      return v;
+    }
+    if (strncmp(s, "major", 5) == 0) { s += 5; return major; }
+    if (strncmp(s, "minor", 5) == 0) { s += 5; return minor; }
+    ok = false;
+    return 0;
+  }
+  
+  const char* s;
+  int major, minor;
+  bool ok;
+};
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+cChannelNumbering::cChannelNumbering(void)
+{
+  confTime = 0;
+  coprocess = -1;
+  toCoprocess = fromCoprocess = -1;
+}
+
+
+//----------------------------------------------------------------------------
+
+cChannelNumbering::~cChannelNumbering()
+{
+  StopCoprocess();
+}
+
+
+//----------------------------------------------------------------------------
+
+void cChannelNumbering::SetDirectory(const char* Directory)
+{
+  cMutexLock lock(&mutex);
+  directory = Directory;
+  confTime = 0;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cChannelNumbering::Close(void)
+{
+  cMutexLock lock(&mutex);
+  StopCoprocess();
+}
+
+
+//----------------------------------------------------------------------------
+
+// numbering.conf, first matching rule wins:
+//
+//   <major>.<minor> = <expression> | ignore | none | script
+//   coprocess = <command>
+//
+// where <major> and <minor> are a number, a range "from-to" or "*".
+void cChannelNumbering::Reload(void)
+{
+  cMutexLock lock(&mutex);
+  
+  cString fileName = AddDirectory(directory, CONF_NAME);
+  struct stat st;
+  time_t mtime = stat(fileName, &st) == 0 ? st.st_mtime : 0;
+  if (mtime == confTime)
+    return;
+    
+  confTime = mtime;
+  rules.clear();
+  cache.clear();
+  StopCoprocess();
+  coprocessCmd = NULL;
+  
+  FILE* f = fopen(fileName, "r");
+  if (!f)
+    return;
+    
+  int lineNum = 0;
+  cReadLine reader;
+  char* line;
+  while ((line = reader.Read(f)) != NULL)
+  {
+    lineNum++;
+    if (char* comment = strchr(line, '#'))
+      *comment = 0;
+    line = skipspace(stripspace(line));
+    if (!*line)
+      continue;
+      
+    if (strncmp(line, "coprocess", 9) == 0 && (line = strchr(line, '='))) {
+      coprocessCmd = skipspace(line + 1);
+      continue;
+    }
+    
+    Rule rule;
+    if (ParseRule(line, rule))
+      rules.push_back(rule);
+    else
+      dprint(L_ERR, "Numbering: error in %s, line %d.", CONF_NAME, lineNum);
+  }
+  fclose(f);
+  
+  dprint(L_DBG, "Numbering: loaded %d rules.", (int) rules.size());
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cChannelNumbering::ParseRange(const char*& s, int& from, int& to)
+{
+  s = skipspace(s);
+  if (*s == '*') {
+    s++;
+    from = 0;
+    to = 0xFFFF;
+    return true;
+  }
+  
+  char* end;
+  from = to = strtol(s, &end, 10);
+  if (end == s)
+    return false;
+  s = end;
+  
+  if (*s == '-') {
+    to = strtol(++s, &end, 10);
+    if (end == s)
+      return false;
+    s = end;
+  }
+  return from <= to;
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cChannelNumbering::ParseRule(const char* line, Rule& rule)
+{
+  const char* s = line;
+  if (!ParseRange(s, rule.majorFrom, rule.majorTo) || *s++ != '.' || !ParseRange(s, rule.minorFrom, rule.minorTo))
+    return false;
+    
+  s = skipspace(s);
+  if (*s++ != '=')
+    return false;
+    
+  s = skipspace(s);
+  rule.expression = s;
+  if (strcmp(s, "ignore") == 0)
+    rule.type = rtIgnore;
+  else if (strcmp(s, "none") == 0)
+    rule.type = rtNone;
+  else if (strcmp(s, "script") == 0)
+    rule.type = rtScript;
+  else {
+    int value;
+    rule.type = rtExpression;
+    return Evaluate(s, 1, 1, value);
+  }
+  
+  return true;
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cChannelNumbering::Evaluate(const char* expression, int major, int minor, int& value)
+{
+  cExpression e(expression, major, minor);
+  return e.Evaluate(value);
+}
+
+
+//----------------------------------------------------------------------------
+
+int cChannelNumbering::Number(uint16_t major, uint16_t minor)
+{
+  cMutexLock lock(&mutex);
+  
+  for (size_t i=0; i<rules.size(); i++)
+  {
+    const Rule& r = rules[i];
+    if (major < r.majorFrom || major > r.majorTo || minor < r.minorFrom || minor > r.minorTo)
+      continue;
+      
+    switch (r.type)
+    {
+      case rtIgnore: 
+        return -1;
+      case rtNone:   
+        return 0;
+      case rtScript: 
+        return Script(major, minor);
+      case rtExpression: 
+      {
+        int value;
+        if (!Evaluate(r.expression.c_str(), major, minor, value)) {
+          dprint(L_ERR, "Numbering: cannot evaluate '%s' for %d.%d.", r.expression.c_str(), major, minor);
+          return 0;
+        }
+        return value < 0 ? -1 : value;
+      }
+    }
+  }
+  
+  return Script(major, minor);
+}
+
+
+//----------------------------------------------------------------------------
+
+// Asks the co-process if there is one, else runs the script for this channel
+int cChannelNumbering::Script(uint16_t major, uint16_t minor)
+{
+  uint32_t key = ((uint32_t) major << 16) | minor;
+  std::map<uint32_t, int>::const_iterator itr = cache.find(key);
+  if (itr != cache.end())
+    return itr->second;
+    
+  int number;
+  if (!*coprocessCmd || !Query(major, minor, number))
+    number = ChannelNumber(AddDirectory(directory, SCRIPT_NAME), major, minor);
+    
+  cache[key] = number;
+  return number;
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cChannelNumbering::StartCoprocess(void)
+{
+  int in[2], out[2];
+  if (pipe(in) < 0)
+    return false;
+  if (pipe(out) < 0) {
+    close(in[0]);
+    close(in[1]);
+    return false;
+  }
+  
+  coprocess = fork();
+  if (coprocess < 0) {
+    close(in[0]); close(in[1]);
+    close(out[0]); close(out[1]);
+    return false;
+  }
+  
+  if (coprocess == 0) 
+  {
+    dup2(in[0], STDIN_FILENO);
+    dup2(out[1], STDOUT_FILENO);
+    for (int fd = STDERR_FILENO + 1; fd < 1024; fd++)
+      close(fd);
+    execl("/bin/sh", "sh", "-c", *coprocessCmd, (char*) NULL);
+    _exit(127);
+  }
+  
+  close(in[0]);
+  close(out[1]);
+  toCoprocess = in[1];
+  fromCoprocess = out[0];
+  fcntl(toCoprocess, F_SETFD, FD_CLOEXEC);
+  fcntl(fromCoprocess, F_SETFD, FD_CLOEXEC);
+  
+  dprint(L_DBG, "Numbering: started '%s'.", *coprocessCmd);
+  return true;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cChannelNumbering::StopCoprocess(void)
+{
+  if (toCoprocess >= 0)
+    close(toCoprocess); // End of input, the co-process should exit
+  if (fromCoprocess >= 0)
+    close(fromCoprocess);
+  toCoprocess = fromCoprocess = -1;
+  
+  if (coprocess > 0) {
+    kill(coprocess, SIGTERM);
+    waitpid(coprocess, NULL, 0);
+  }
+  coprocess = -1;
+}
+
+
+//----------------------------------------------------------------------------
+
+// Writes "major minor" and reads back a line with the number
+bool cChannelNumbering::Query(uint16_t major, uint16_t minor, int& number)
+{
+  if (coprocess < 0 && !StartCoprocess())
+    return false;
+    
+  char query[32];
+  int queryLength = snprintf(query, sizeof(query), "%d %d\n", major, minor);
+  
+  // The co-process may have died, SIGPIPE is ignored by VDR
+  if (write(toCoprocess, query, queryLength) != queryLength) {
+    dprint(L_ERR, "Numbering: co-process not responding, restarting.");
+    StopCoprocess();
+    return false;
+  }
+  
+  // The whole line is read, or the rest would be taken as the next answer
+  char buffer[32];
+  int len = 0;
+  for (int total = 0; ; total++)
+  {
+    char c;
+    struct pollfd pfd = { fromCoprocess, POLLIN, 0 };
+    if (total > MAX_ANSWER || poll(&pfd, 1, COPROCESS_TIMEOUT) <= 0 || read(fromCoprocess, &c, 1) != 1) {
+      dprint(L_ERR, "Numbering: no answer from co-process for %d.%d.", major, minor);
+      StopCoprocess();
+      return false;
+    }
+    if (c == '\n')
+      break;
+    if (len < (int) sizeof(buffer) - 1)
+      buffer[len++] = c;
+  }
+  
+  buffer[len] = 0;
+  number = atoi(buffer);
+  return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
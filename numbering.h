@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2006-2010 Alex Lasnier <alex@fepg.org>
+ *
+ * This file is part of ATSC EPG
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __ATSC_NUMBERING_H
+#define __ATSC_NUMBERING_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+#include <vdr/thread.h>
+#include <vdr/tools.h>
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+// Assigns VDR channel numbers to major.minor virtual channels, following the
+// rules in numbering.conf. Channels no rule matches are numbered by the 
+// "number" script, which may also run as a co-process answering one query 
+// per line. Returns -1 to ignore a channel and 0 to leave it unnumbered.
+class cChannelNumbering
+{
+public:
+  cChannelNumbering(void);
+ ~cChannelNumbering();
+ 
+  void SetDirectory(const char* Directory);
+  void Reload(void); // If numbering.conf has changed
+  void Close(void);  // Ends the co-process
+  int Number(uint16_t major, uint16_t minor);
+  
+private:
+  enum RuleType { rtExpression, rtIgnore, rtNone, rtScript };
+  
+  struct Rule {
+    int majorFrom, majorTo;
+    int minorFrom, minorTo;
+    RuleType type;
+    std::string expression;
+  };
+  
+  bool ParseRule(const char* line, Rule& rule);
+  static bool ParseRange(const char*& s, int& from, int& to);
+  static bool Evaluate(const char* expression, int major, int minor, int& value);
+  
+  int Script(uint16_t major, uint16_t minor);
+  bool StartCoprocess(void);
+  void StopCoprocess(void);
+  bool Query(uint16_t major, uint16_t minor, int& number);
+  
+  cString directory;
+  time_t confTime;
+  std::vector<Rule> rules;
+  std::map<uint32_t, int> cache; // major << 16 | minor -> script's answer
+  
+  cString coprocessCmd;
+  pid_t coprocess;
+  int toCoprocess;
+  int fromCoprocess;
+  
+  cMutex mutex;
+};
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+extern cChannelNumbering ChannelNumbering;
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+#endif //__ATSC_NUMBERING_H
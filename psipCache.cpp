@@ -0,0 +1,818 @@
+/*
+ * Copyright (C) 2006-2010 Alex Lasnier <alex@fepg.org>
+ *
+ * This file is part of ATSC EPG
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+
+#include <vdr/channels.h>
+#include <vdr/sources.h>
+
+#include "psipCache.h"
+#include "filterManager.h"
+#include "vdrInterface.h"
+#include "guideStore.h"
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+#define CACHE_MAGIC      "ATSCEPG"
+#define CACHE_VERSION    1
+#define CACHE_BYTE_ORDER 0x01020304
+
+#define COMPACT_SIZE     (1024 * 1024) // Journal size that triggers a snapshot
+#define COMPACT_DELAY    3600          // Snapshot at least this often (s)
+
+cPsipCache PsipCache;
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+// File layout: a FileHeader followed by one record per transponder. Each 
+// TransponderHeader is followed by its table versions, channels, events and
+// texts. Titles and texts are padded to 4 bytes so every record is aligned.
+// Journal records use the same encoding for their payload.
+
+struct FileHeader {
+  char     magic[8];
+  uint32_t version;
+  uint32_t byteOrder;
+  uint32_t attributesSize;
+  uint32_t numTransponders;
+};
+
+struct TransponderHeader {
+  int32_t  transponder;
+  uint16_t tsid;
+  uint8_t  mgtVersion; // 0xFF = none
+  uint8_t  vctVersion; // 0xFF = none
+  uint32_t numTableVersions;
+  uint32_t numChannels;
+  uint32_t numEvents;
+  uint32_t numTexts;
+};
+
+struct TableVersionRecord {
+  uint16_t tableType;
+  uint8_t  version;
+  uint8_t  reserved;
+};
+
+struct ChannelRecord {
+  uint16_t sourceId;
+  uint16_t programNumber;
+  uint16_t majorNumber;
+  uint16_t minorNumber;
+  uint8_t  hasEit;
+  uint8_t  reserved[3];
+};
+
+struct EventRecord {
+  uint16_t sourceId;
+  uint16_t eventId;
+  uint32_t startTime;
+  uint32_t duration;
+  uint8_t  version;
+  uint8_t  tableId;
+  uint8_t  etmLocation;
+  uint8_t  reserved;
+  uint16_t titleLength;
+  uint16_t reserved2;
+  EventAttributes attributes;
+}; // followed by the title
+
+struct TextRecord {
+  uint16_t sourceId;
+  uint16_t eventId;
+  uint16_t length;
+  uint16_t reserved;
+}; // followed by the raw multiple string structure
+
+// Journal payload headers
+struct VersionsHeader {
+  uint8_t  mgtVersion;
+  uint8_t  reserved[3];
+  uint32_t numTableVersions;
+};
+
+struct ChannelsHeader {
+  uint16_t tsid;
+  uint8_t  vctVersion;
+  uint8_t  reserved;
+  uint32_t numChannels;
+};
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+static inline size_t Padded(size_t n) { return (n + 3) & ~3; }
+
+
+class cCacheReader
+{
+public:
+  cCacheReader(const uint8_t* Data, size_t Size) { data = Data; end = Data + Size; }
+  
+  const uint8_t* Get(size_t n) {
+    if (n > size_t(end - data))
+      return NULL;
+    const uint8_t* p = data;
+    data += Padded(n) <= size_t(end - data) ? Padded(n) : n;
+    return p;
+  }
+  
+  template <class T> bool Read(T& t) {
+    const uint8_t* p = Get(sizeof(T));
+    if (p)
+      memcpy(&t, p, sizeof(T));
+    return p != NULL;
+  }
+  
+private:
+  const uint8_t* data;
+  const uint8_t* end;
+};
+
+
+static void Append(std::string& s, const void* data, size_t n)
+{
+  s.append((const char*) data, n);
+  s.append(Padded(n) - n, '\0');
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+cPsipCache::cPsipCache(void)
+{
+  fileName = NULL;
+  lastSave = 0;
+}
+
+
+//----------------------------------------------------------------------------
+
+cPsipCache::~cPsipCache()
+{
+  free(fileName);
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cPsipCache::Load(const char* FileName)
+{
+  cMutexLock lock(&mutex);
+  
+  free(fileName);
+  fileName = strdup(FileName);
+  transponders.clear();
+  lastSave = time(NULL);
+  
+  bool ok = false;
+  bool invalid = false;
+  int fd = open(fileName, O_RDONLY);
+  if (fd >= 0) 
+  {
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size >= (off_t) sizeof(FileHeader)) 
+    {
+      void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data != MAP_FAILED) {
+        ok = Parse((const uint8_t*) data, st.st_size);
+        munmap(data, st.st_size);
+      }
+    }
+    close(fd);
+    
+    if (!ok) {
+      dprint(L_ERR, "PSIP cache: %s is invalid, ignoring it.", fileName);
+      transponders.clear();
+      GuideStore.Clear();
+      invalid = true;
+    }
+  }
+  
+  // Apply the changes made after the snapshot was written. Without the 
+  // snapshot the journal's table versions would claim events that are 
+  // gone, so it is dropped as well and everything is acquired again.
+  cString journalName = cString::sprintf("%s.journal", fileName);
+  cPsipJournalReader reader(journalName);
+  
+  uint8_t type;
+  int transponder;
+  const uint8_t* data;
+  size_t length;
+  int numRecords = 0;
+  off_t validSize = 0; // A record that fails to replay is cut along with the rest
+  
+  while (!invalid && reader.Next(type, transponder, data, length) && Replay(type, transponder, data, length)) {
+    validSize = reader.ValidSize();
+    numRecords++;
+  }
+  
+  if (!invalid && validSize < reader.Size())
+    dprint(L_ERR, "PSIP cache: cutting %s at offset %d of %d.", *journalName, (int) validSize, (int) reader.Size());
+  journal.Open(journalName, validSize);
+  
+  dprint(L_MSG, "PSIP cache: loaded %d transponder(s), %d journal record(s).", (int) transponders.size(), numRecords);
+  return !transponders.empty();
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cPsipCache::Parse(const uint8_t* data, size_t size)
+{
+  cCacheReader r(data, size);
+  
+  FileHeader fh;
+  if (!r.Read(fh) || memcmp(fh.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0)
+    return false;
+  if (fh.version != CACHE_VERSION || fh.byteOrder != CACHE_BYTE_ORDER || fh.attributesSize != sizeof(EventAttributes))
+    return false;
+    
+  for (uint32_t t=0; t<fh.numTransponders; t++)
+  {
+    TransponderHeader th;
+    if (!r.Read(th))
+      return false;
+      
+    Transponder& tp = transponders[th.transponder];
+    tp.tsid = th.tsid;
+    tp.mgtVersion = (th.mgtVersion == 0xFF) ? -1 : th.mgtVersion;
+    tp.vctVersion = (th.vctVersion == 0xFF) ? -1 : th.vctVersion;
+    
+    if (!DecodeVersions(r, th.numTableVersions, tp.tableVersions) || !DecodeChannels(r, th.numChannels, tp.channels))
+      return false;
+      
+    ChannelMap channelMap;
+    channelMap.tsid = tp.tsid;
+    channelMap.channels = tp.channels;
+    GuideStore.SetChannels(th.transponder, channelMap);
+      
+    if (!DecodeEvents(r, th.numEvents, th.transponder) || !DecodeTexts(r, th.numTexts, th.transponder))
+      return false;
+  }
+  
+  return true;
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cPsipCache::Replay(uint8_t type, int transponder, const uint8_t* data, size_t length)
+{
+  cCacheReader r(data, length);
+  
+  switch (type)
+  {
+    case cPsipJournal::jrVersions:
+    {
+      VersionsHeader h;
+      std::map<uint16_t, uint8_t> tableVersions;
+      if (!r.Read(h) || !DecodeVersions(r, h.numTableVersions, tableVersions))
+        return false;
+      Transponder& tp = transponders[transponder];
+      tp.mgtVersion = h.mgtVersion;
+      tp.tableVersions = tableVersions;
+    }
+    break;
+    
+    case cPsipJournal::jrChannels:
+    {
+      ChannelsHeader h;
+      std::vector<CachedChannel> channels;
+      if (!r.Read(h) || !DecodeChannels(r, h.numChannels, channels))
+        return false;
+      ApplyChannels(transponder, h.tsid, h.vctVersion, channels);
+    }
+    break;
+    
+    case cPsipJournal::jrEvents:
+    {
+      uint32_t count;
+      if (!r.Read(count) || !DecodeEvents(r, count, transponder))
+        return false;
+    }
+    break;
+    
+    case cPsipJournal::jrText:
+      if (!DecodeTexts(r, 1, transponder))
+        return false;
+    break;
+    
+    default:
+      dprint(L_ERR, "PSIP cache: unknown journal record type %d.", type);
+      return false;
+  }
+  
+  return true;
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cPsipCache::Save(void)
+{
+  cMutexLock lock(&mutex);
+  
+  if (!fileName)
+    return false;
+    
+  cString tmpName = cString::sprintf("%s.new", fileName);
+  FILE* f = fopen(tmpName, "w");
+  if (!f) {
+    dprint(L_ERR, "PSIP cache: cannot create %s.", *tmpName);
+    return false;
+  }
+  
+  bool ok = Write(f);
+  if (fflush(f) != 0 || fdatasync(fileno(f)) != 0)
+    ok = false;
+  if (fclose(f) != 0)
+    ok = false;
+    
+  // Replace the old cache in one step, a reader never sees a partial file
+  if (!ok || rename(tmpName, fileName) < 0) {
+    dprint(L_ERR, "PSIP cache: cannot write %s.", fileName);
+    unlink(tmpName);
+    return false;
+  }
+  
+  // Everything in the journal is now part of the snapshot
+  journal.Truncate();
+  lastSave = time(NULL);
+  
+  dprint(L_DBG, "PSIP cache: saved %d transponder(s).", (int) transponders.size());
+  return true;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cPsipCache::Compact(void)
+{
+  Prune();
+  
+  off_t size = journal.Size();
+  if (size >= COMPACT_SIZE || (size > 0 && time(NULL) - lastSave >= COMPACT_DELAY))
+    Save();
+}
+
+
+//----------------------------------------------------------------------------
+
+void cPsipCache::Close(void)
+{
+  if (journal.Size() > 0)
+    Save();
+  journal.Close();
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cPsipCache::Write(FILE* f)
+{
+  FileHeader fh;
+  memset(&fh, 0, sizeof(fh));
+  memcpy(fh.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+  fh.version = CACHE_VERSION;
+  fh.byteOrder = CACHE_BYTE_ORDER;
+  fh.attributesSize = sizeof(EventAttributes);
+  fh.numTransponders = transponders.size();
+  if (fwrite(&fh, sizeof(fh), 1, f) != 1)
+    return false;
+    
+  for (TransponderMap::const_iterator t = transponders.begin(); t != transponders.end(); t++)
+  {
+    const Transponder& tp = t->second;
+    
+    TransponderHeader th;
+    memset(&th, 0, sizeof(th));
+    th.transponder = t->first;
+    th.tsid = tp.tsid;
+    th.mgtVersion = (tp.mgtVersion < 0) ? 0xFF : tp.mgtVersion;
+    th.vctVersion = (tp.vctVersion < 0) ? 0xFF : tp.vctVersion;
+    th.numTableVersions = tp.tableVersions.size();
+    th.numChannels = tp.channels.size();
+    
+    std::vector<cGuideStore::Entry> entries;
+    GuideStore.GetEvents(t->first, entries);
+    
+    std::string events, texts;
+    for (unsigned int i=0; i<entries.size(); i++) 
+    {
+      const cGuideStore::Entry& e = entries[i];
+      EncodeEvent(events, e.sourceId, e.event);
+      th.numEvents++;
+      if (!e.text.empty()) {
+        EncodeText(texts, ((uint32_t) e.sourceId << 16) | e.event.event_id, e.text);
+        th.numTexts++;
+      }
+    }
+    
+    std::string s;
+    Append(s, &th, sizeof(th));
+    EncodeVersions(s, tp.tableVersions);
+    EncodeChannels(s, tp.channels);
+    s += events;
+    s += texts;
+      
+    if (fwrite(s.data(), s.size(), 1, f) != 1)
+      return false;
+  }
+  
+  return true;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cPsipCache::Prune(void)
+{
+  int dropped = GuideStore.DropEnded(time(NULL));
+  if (dropped)
+    dprint(L_DBG, "PSIP cache: dropped %d ended event(s).", dropped);
+}
+
+
+//----------------------------------------------------------------------------
+
+void cPsipCache::EncodeVersions(std::string& s, const std::map<uint16_t, uint8_t>& tableVersions)
+{
+  for (std::map<uint16_t, uint8_t>::const_iterator i = tableVersions.begin(); i != tableVersions.end(); i++) {
+    TableVersionRecord tv;
+    memset(&tv, 0, sizeof(tv));
+    tv.tableType = i->first;
+    tv.version = i->second;
+    Append(s, &tv, sizeof(tv));
+  }
+}
+
+
+//----------------------------------------------------------------------------
+
+void cPsipCache::EncodeChannels(std::string& s, const std::vector<CachedChannel>& channels)
+{
+  for (std::vector<CachedChannel>::const_iterator i = channels.begin(); i != channels.end(); i++) {
+    ChannelRecord cr;
+    memset(&cr, 0, sizeof(cr));
+    cr.sourceId = i->sourceId;
+    cr.programNumber = i->programNumber;
+    cr.majorNumber = i->majorNumber;
+    cr.minorNumber = i->minorNumber;
+    cr.hasEit = i->hasEit;
+    Append(s, &cr, sizeof(cr));
+  }
+}
+
+
+//----------------------------------------------------------------------------
+
+void cPsipCache::EncodeEvent(std::string& s, uint16_t sourceId, const Event& event)
+{
+  const char* title = event.TitleText() ? event.TitleText() : "";
+  
+  EventRecord er;
+  er.sourceId = sourceId;
+  er.eventId = event.event_id;
+  er.startTime = event.start_time;
+  er.duration = event.length_in_seconds;
+  er.version = event.version_number;
+  er.tableId = event.table_id;
+  er.etmLocation = event.ETM_location;
+  er.reserved = 0;
+  er.titleLength = std::min(strlen(title), (size_t) 0xFFFF);
+  er.reserved2 = 0;
+  er.attributes = event.attributes;
+  
+  Append(s, &er, sizeof(er));
+  Append(s, title, er.titleLength);
+}
+
+
+//----------------------------------------------------------------------------
+
+void cPsipCache::EncodeText(std::string& s, uint32_t key, const std::string& text)
+{
+  TextRecord tr;
+  tr.sourceId = key >> 16;
+  tr.eventId = key & 0xFFFF;
+  tr.length = std::min(text.size(), (size_t) 0xFFFF);
+  tr.reserved = 0;
+  
+  Append(s, &tr, sizeof(tr));
+  Append(s, text.data(), tr.length);
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cPsipCache::DecodeVersions(cCacheReader& r, uint32_t count, std::map<uint16_t, uint8_t>& tableVersions)
+{
+  for (uint32_t i=0; i<count; i++) {
+    TableVersionRecord tv;
+    if (!r.Read(tv))
+      return false;
+    tableVersions[tv.tableType] = tv.version;
+  }
+  return true;
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cPsipCache::DecodeChannels(cCacheReader& r, uint32_t count, std::vector<CachedChannel>& channels)
+{
+  for (uint32_t i=0; i<count; i++) {
+    ChannelRecord cr;
+    if (!r.Read(cr))
+      return false;
+    CachedChannel c;
+    c.sourceId = cr.sourceId;
+    c.programNumber = cr.programNumber;
+    c.majorNumber = cr.majorNumber;
+    c.minorNumber = cr.minorNumber;
+    c.hasEit = cr.hasEit;
+    channels.push_back(c);
+  }
+  return true;
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cPsipCache::DecodeEvents(cCacheReader& r, uint32_t count, int transponder)
+{
+  Event e;
+  for (uint32_t i=0; i<count; i++) {
+    EventRecord er;
+    if (!r.Read(er))
+      return false;
+    const uint8_t* title = r.Get(er.titleLength);
+    if (!title)
+      return false;
+      
+    e.event_id = er.eventId;
+    e.start_time = er.startTime;
+    e.length_in_seconds = er.duration;
+    e.version_number = er.version;
+    e.table_id = er.tableId;
+    e.ETM_location = er.etmLocation;
+    e.attributes = er.attributes;
+    e.SetTitleText(std::string((const char*) title, er.titleLength).c_str());
+    GuideStore.AddEvent(transponder, er.sourceId, e);
+  }
+  return true;
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cPsipCache::DecodeTexts(cCacheReader& r, uint32_t count, int transponder)
+{
+  for (uint32_t i=0; i<count; i++) {
+    TextRecord tr;
+    if (!r.Read(tr))
+      return false;
+    const uint8_t* text = r.Get(tr.length);
+    if (!text)
+      return false;
+    GuideStore.SetText(transponder, tr.sourceId, tr.eventId, (const char*) text, tr.length);
+  }
+  return true;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cPsipCache::Populate(void)
+{
+  cMutexLock lock(&mutex);
+  
+  int numEvents = 0;
+  
+  for (TransponderMap::const_iterator t = transponders.begin(); t != transponders.end(); t++)
+  {
+    const Transponder& tp = t->second;
+    
+    if (tp.mgtVersion >= 0)
+      FilterManager.SetMgtVersion(t->first, tp.mgtVersion);
+      
+    if (tp.vctVersion >= 0) {
+      ChannelMap channelMap;
+      channelMap.tsid = tp.tsid;
+      channelMap.version = tp.vctVersion;
+      channelMap.channels = tp.channels;
+      FilterManager.PutChannelMap(t->first, channelMap);
+    }
+    
+    std::vector<cGuideStore::Entry> entries;
+    GuideStore.GetEvents(t->first, entries);
+    
+    // Entries are sorted by source id and start time
+    std::map<uint16_t, std::pair<unsigned int, unsigned int> > ranges;
+    for (unsigned int i=0, j; i<entries.size(); i=j) {
+      for (j=i+1; j<entries.size() && entries[j].sourceId == entries[i].sourceId; j++)
+        ;
+      ranges[entries[i].sourceId] = std::make_pair(i, j);
+    }
+    
+    for (std::vector<CachedChannel>::const_iterator c = tp.channels.begin(); c != tp.channels.end(); c++)
+    {
+      std::map<uint16_t, std::pair<unsigned int, unsigned int> >::const_iterator r = ranges.find(c->sourceId);
+      if (r == ranges.end())
+        continue;
+        
+      cChannel* channel = Channels.GetByChannelID(tChannelID(cSource::stAtsc, 0, tp.tsid, c->programNumber), true);
+      if (!channel)
+        continue;
+        
+      std::vector<Event> events;
+      for (unsigned int i=r->second.first; i<r->second.second; i++)
+        events.push_back(entries[i].event);
+      
+      // Add runs of events from the same table version together, so that
+      // dropping outdated events never removes events of another table.
+      for (unsigned int i=0, j; i<events.size(); i=j) {
+        for (j=i+1; j<events.size() && events[j].version_number == events[i].version_number; j++)
+          ;
+        VDRInterface::AddEvents(channel, &events[i], j-i);
+      }
+      numEvents += events.size();
+      
+      for (unsigned int i=r->second.first; i<r->second.second; i++) {
+        const cGuideStore::Entry& e = entries[i];
+        if (!e.text.empty())
+          VDRInterface::AddDescription(channel, e.event.event_id, (const u8*) e.text.data(), e.text.size());
+      }
+    }
+  }
+  
+  dprint(L_MSG, "PSIP cache: added %d event(s) to the schedules.", numEvents);
+}
+
+
+//----------------------------------------------------------------------------
+
+int cPsipCache::GetTableVersion(int transponder, uint16_t tableType)
+{
+  cMutexLock lock(&mutex);
+  
+  TransponderMap::const_iterator t = transponders.find(transponder);
+  if (t == transponders.end())
+    return -1;
+    
+  std::map<uint16_t, uint8_t>::const_iterator v = t->second.tableVersions.find(tableType);
+  if (v == t->second.tableVersions.end())
+    return -1;
+    
+  return v->second;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cPsipCache::SetVersions(int transponder, uint8_t mgtVersion, const std::map<uint16_t, uint8_t>& tableVersions)
+{
+  cMutexLock lock(&mutex);
+  
+  Transponder& tp = transponders[transponder];
+  tp.mgtVersion = mgtVersion;
+  tp.tableVersions = tableVersions;
+  
+  VersionsHeader h;
+  memset(&h, 0, sizeof(h));
+  h.mgtVersion = mgtVersion;
+  h.numTableVersions = tableVersions.size();
+  
+  std::string s;
+  Append(s, &h, sizeof(h));
+  EncodeVersions(s, tableVersions);
+  journal.Append(cPsipJournal::jrVersions, transponder, s);
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cPsipCache::SetChannels(int transponder, const ChannelMap& channelMap)
+{
+  cMutexLock lock(&mutex);
+  
+  Transponder& tp = transponders[transponder];
+  if (tp.vctVersion == channelMap.version && tp.tsid == channelMap.tsid)
+    return false;
+    
+  ChannelsHeader h;
+  memset(&h, 0, sizeof(h));
+  h.tsid = channelMap.tsid;
+  h.vctVersion = channelMap.version;
+  h.numChannels = channelMap.channels.size();
+  
+  std::string s;
+  Append(s, &h, sizeof(h));
+  EncodeChannels(s, channelMap.channels);
+  journal.Append(cPsipJournal::jrChannels, transponder, s);
+  
+  return ApplyChannels(transponder, channelMap.tsid, channelMap.version, channelMap.channels);
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cPsipCache::ApplyChannels(int transponder, uint16_t tsid, uint8_t vctVersion, const std::vector<CachedChannel>& channels)
+{
+  Transponder& tp = transponders[transponder];
+  bool changed = (tp.vctVersion >= 0 && tp.tsid != tsid);
+  
+  if (changed) {
+    // A different transport stream, nothing cached for it is valid
+    dprint(L_MSG, "PSIP cache: TSID changed on transponder %d (%d -> %d)", transponder, tp.tsid, tsid);
+    tp = Transponder();
+    GuideStore.ClearTransponder(transponder);
+  }
+  
+  tp.tsid = tsid;
+  tp.vctVersion = vctVersion;
+  tp.channels = channels;
+  
+  ChannelMap channelMap;
+  channelMap.tsid = tsid;
+  channelMap.version = vctVersion;
+  channelMap.channels = channels;
+  GuideStore.SetChannels(transponder, channelMap);
+  
+  return changed;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cPsipCache::AddEvents(int transponder, const EIT& eit)
+{
+  cMutexLock lock(&mutex);
+  
+  uint32_t numChanged = 0;
+  std::string s;
+  
+  for (int i=0; i<eit.NumberOfEvents(); i++) 
+  {
+    // Only changes go to the journal
+    const Event* e = eit.GetEvent(i);
+    if (GuideStore.AddEvent(transponder, eit.SourceID(), *e)) {
+      EncodeEvent(s, eit.SourceID(), *e);
+      numChanged++;
+    }
+  }
+  
+  if (numChanged) {
+    std::string payload;
+    Append(payload, &numChanged, sizeof(numChanged));
+    journal.Append(cPsipJournal::jrEvents, transponder, payload + s);
+  }
+}
+
+
+//----------------------------------------------------------------------------
+
+void cPsipCache::AddText(int transponder, const ETT& ett)
+{
+  if (!ett.EventID() || !ett.RawText() || ett.RawTextLength() <= 0)
+    return;
+
+  cMutexLock lock(&mutex);
+  
+  if (!GuideStore.SetText(transponder, ett.SourceID(), ett.EventID(), (const char*) ett.RawText(), ett.RawTextLength()))
+    return;
+  
+  std::string s;
+  EncodeText(s, ((uint32_t) ett.SourceID() << 16) | ett.EventID(), std::string((const char*) ett.RawText(), ett.RawTextLength()));
+  journal.Append(cPsipJournal::jrText, transponder, s);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
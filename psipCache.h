@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2006-2010 Alex Lasnier <alex@fepg.org>
+ *
+ * This file is part of ATSC EPG
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __ATSC_PSIP_CACHE_H
+#define __ATSC_PSIP_CACHE_H
+
+#include <map>
+#include <vector>
+#include <string>
+
+#include <vdr/thread.h>
+
+#include "tables.h"
+#include "structs.h"
+#include "psipJournal.h"
+
+
+class cCacheReader;
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+// On-disk copy of the PSIP data acquired for each transponder: MGT and table
+// versions, the VCT channel map, and the events and (compressed) ETT texts
+// held in the guide store. It is 
+// loaded when the plugin starts so schedules are available right away, and
+// the filters only have to acquire the tables that changed since.
+//
+// Changes are appended to a journal as they are acquired; the snapshot is 
+// only rewritten when the journal is compacted.
+class cPsipCache
+{
+public:
+  cPsipCache(void);
+ ~cPsipCache();
+ 
+  bool Load(const char* FileName);
+  bool Save(void);
+  void Compact(void);
+  void Close(void);
+  void Populate(void);
+  
+  int  GetTableVersion(int transponder, uint16_t tableType);
+  void SetVersions(int transponder, uint8_t mgtVersion, const std::map<uint16_t, uint8_t>& tableVersions);
+  bool SetChannels(int transponder, const ChannelMap& channelMap);
+  void AddEvents(int transponder, const EIT& eit);
+  void AddText(int transponder, const ETT& ett);
+  
+private:
+  typedef ChannelMap::Entry CachedChannel;
+  
+  struct Transponder {
+    Transponder(void) { tsid = 0; mgtVersion = -1; vctVersion = -1; }
+    
+    uint16_t tsid;
+    int mgtVersion; // -1 until a complete acquisition
+    int vctVersion;
+    std::map<uint16_t, uint8_t> tableVersions;
+    std::vector<CachedChannel> channels;
+  };
+  
+  typedef std::map<int, Transponder> TransponderMap;
+  
+  bool Parse(const uint8_t* data, size_t size);
+  bool Replay(uint8_t type, int transponder, const uint8_t* data, size_t length);
+  bool Write(FILE* f);
+  void Prune(void);
+  bool ApplyChannels(int transponder, uint16_t tsid, uint8_t vctVersion, const std::vector<CachedChannel>& channels);
+  
+  static void EncodeVersions(std::string& s, const std::map<uint16_t, uint8_t>& tableVersions);
+  static void EncodeChannels(std::string& s, const std::vector<CachedChannel>& channels);
+  static void EncodeEvent(std::string& s, uint16_t sourceId, const Event& event);
+  static void EncodeText(std::string& s, uint32_t key, const std::string& text);
+  static bool DecodeVersions(cCacheReader& r, uint32_t count, std::map<uint16_t, uint8_t>& tableVersions);
+  static bool DecodeChannels(cCacheReader& r, uint32_t count, std::vector<CachedChannel>& channels);
+  static bool DecodeEvents(cCacheReader& r, uint32_t count, int transponder);
+  static bool DecodeTexts(cCacheReader& r, uint32_t count, int transponder);
+  
+  TransponderMap transponders;
+  char* fileName;
+  time_t lastSave;
+  cPsipJournal journal;
+  cMutex mutex;
+};
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+extern cPsipCache PsipCache;
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+#endif //__ATSC_PSIP_CACHE_H
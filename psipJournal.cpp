@@ -0,0 +1,274 @@
+/*
+ * Copyright (C) 2006-2010 Alex Lasnier <alex@fepg.org>
+ *
+ * This file is part of ATSC EPG
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stddef.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <libsi/util.h>
+
+#include "psipJournal.h"
+#include "log.h"
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+#define JOURNAL_MAGIC          0x4A455441 // "ATEJ"
+#define JOURNAL_FLUSH_INTERVAL 5000       // ms
+
+struct JournalHeader {
+  uint32_t magic;
+  uint32_t length; // Payload length, padded to 4 bytes in the file
+  uint32_t crc;    // Over type, transponder and payload
+  uint8_t  type;
+  uint8_t  reserved[3];
+  int32_t  transponder;
+};
+
+#define CRC_START offsetof(JournalHeader, type)
+
+
+static inline size_t Padded(size_t n) { return (n + 3) & ~3; }
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+cPsipJournal::cPsipJournal(void) : cThread("ATSC PSIP journal", true)
+{
+  fd = -1;
+  size = 0;
+}
+
+
+//----------------------------------------------------------------------------
+
+cPsipJournal::~cPsipJournal()
+{
+  Close();
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cPsipJournal::Open(const char* FileName, off_t ValidSize)
+{
+  Close();
+  
+  fd = open(FileName, O_WRONLY | O_CREAT | O_APPEND, 0644);
+  if (fd < 0) {
+    dprint(L_ERR, "PSIP journal: cannot open %s.", FileName);
+    return false;
+  }
+  
+  // Drop a partially written record left by a crash
+  if (ftruncate(fd, ValidSize) < 0) {
+    dprint(L_ERR, "PSIP journal: cannot truncate %s.", FileName);
+    close(fd);
+    fd = -1;
+    return false;
+  }
+  
+  size = ValidSize;
+  Start();
+  return true;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cPsipJournal::Close(void)
+{
+  if (fd < 0)
+    return;
+    
+  // Clear the running flag first, or the thread may go back to waiting
+  Cancel(-1);
+  wait.Signal();
+  Cancel(3);
+  Flush();
+  
+  close(fd);
+  fd = -1;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cPsipJournal::Append(uint8_t type, int transponder, const std::string& payload)
+{
+  JournalHeader h;
+  h.magic = JOURNAL_MAGIC;
+  h.length = payload.size();
+  h.type = type;
+  h.reserved[0] = h.reserved[1] = h.reserved[2] = 0;
+  h.transponder = transponder;
+  h.crc = SI::CRC32::crc32((const char*) &h + CRC_START, sizeof(h) - CRC_START, 0xFFFFFFFF);
+  h.crc = SI::CRC32::crc32(payload.data(), payload.size(), h.crc);
+  
+  cMutexLock lock(&mutex);
+  
+  if (fd < 0)
+    return;
+    
+  pending.append((const char*) &h, sizeof(h));
+  pending.append(payload);
+  pending.append(Padded(payload.size()) - payload.size(), '\0');
+  size += sizeof(h) + Padded(payload.size());
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cPsipJournal::Truncate(void)
+{
+  cMutexLock writeLock(&writeMutex);
+  cMutexLock lock(&mutex);
+  
+  pending.clear();
+  size = 0;
+  
+  return fd < 0 || ftruncate(fd, 0) == 0;
+}
+
+
+//----------------------------------------------------------------------------
+
+off_t cPsipJournal::Size(void)
+{
+  cMutexLock lock(&mutex);
+  return size;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cPsipJournal::Action(void)
+{
+  while (Running()) 
+  {
+    wait.Wait(JOURNAL_FLUSH_INTERVAL);
+    Flush();
+  }
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cPsipJournal::Flush(void)
+{
+  cMutexLock writeLock(&writeMutex);
+  
+  std::string data;
+  {
+    cMutexLock lock(&mutex);
+    data.swap(pending);
+  }
+  
+  if (data.empty() || fd < 0)
+    return true;
+    
+  const char* p = data.data();
+  size_t left = data.size();
+  while (left > 0) 
+  {
+    ssize_t n = write(fd, p, left);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      dprint(L_ERR, "PSIP journal: write failed (%s).", strerror(errno));
+      return false;
+    }
+    p += n;
+    left -= n;
+  }
+  
+  fdatasync(fd);
+  return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+cPsipJournalReader::cPsipJournalReader(const char* FileName)
+{
+  map = NULL;
+  mapSize = 0;
+  offset = 0;
+  
+  int fd = open(FileName, O_RDONLY);
+  if (fd < 0)
+    return;
+    
+  struct stat st;
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data != MAP_FAILED) {
+      map = (uint8_t*) data;
+      mapSize = st.st_size;
+    }
+  }
+  close(fd);
+}
+
+
+//----------------------------------------------------------------------------
+
+cPsipJournalReader::~cPsipJournalReader()
+{
+  if (map)
+    munmap(map, mapSize);
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cPsipJournalReader::Next(uint8_t& type, int& transponder, const uint8_t*& data, size_t& length)
+{
+  if (!map || mapSize - offset < sizeof(JournalHeader))
+    return false;
+    
+  JournalHeader h;
+  memcpy(&h, map + offset, sizeof(h));
+  if (h.magic != JOURNAL_MAGIC || Padded(h.length) > mapSize - offset - sizeof(h))
+    return false;
+    
+  const uint8_t* payload = map + offset + sizeof(h);
+  uint32_t crc = SI::CRC32::crc32((const char*) &h + CRC_START, sizeof(h) - CRC_START, 0xFFFFFFFF);
+  if (SI::CRC32::crc32((const char*) payload, h.length, crc) != h.crc) {
+    dprint(L_ERR, "PSIP journal: bad checksum at offset %d, ignoring the rest.", (int) offset);
+    return false;
+  }
+  
+  type = h.type;
+  transponder = h.transponder;
+  data = payload;
+  length = h.length;
+  
+  offset += sizeof(h) + Padded(h.length);
+  return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2006-2010 Alex Lasnier <alex@fepg.org>
+ *
+ * This file is part of ATSC EPG
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __ATSC_PSIP_JOURNAL_H
+#define __ATSC_PSIP_JOURNAL_H
+
+#include <string>
+#include <sys/types.h>
+
+#include <vdr/thread.h>
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+// Append-only log of the changes made to the PSIP cache since its last
+// snapshot. Records are buffered and written in batches by a background 
+// thread; each one carries a CRC so a torn write at the end of the file is 
+// detected and dropped on replay.
+class cPsipJournal : public cThread
+{
+public:
+  enum RecordType {
+    jrVersions = 1,
+    jrChannels,
+    jrEvents,
+    jrText
+  };
+  
+  cPsipJournal(void);
+  virtual ~cPsipJournal();
+  
+  bool Open(const char* FileName, off_t ValidSize);
+  void Close(void);
+  void Append(uint8_t type, int transponder, const std::string& payload);
+  bool Truncate(void);
+  off_t Size(void);
+  
+protected:
+  virtual void Action(void);
+  
+private:
+  bool Flush(void);
+  
+  int fd;
+  off_t size;
+  std::string pending;
+  cMutex mutex;      // Protects pending and size
+  cMutex writeMutex; // Serializes access to the file
+  cCondWait wait;
+};
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+class cPsipJournalReader
+{
+public:
+  cPsipJournalReader(const char* FileName);
+ ~cPsipJournalReader();
+ 
+  bool Next(uint8_t& type, int& transponder, const uint8_t*& data, size_t& length);
+  off_t ValidSize(void) const { return offset; } // Up to the end of the last record read
+  off_t Size(void) const { return mapSize; }
+  
+private:
+  uint8_t* map;
+  size_t mapSize;
+  size_t offset;
+};
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+#endif //__ATSC_PSIP_JOURNAL_H
@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2006-2010 Alex Lasnier <alex@fepg.org>
+ *
+ * This file is part of ATSC EPG
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ratingTables.h"
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+#define BUILT_IN_VERSION 0xFF // Not a valid version, any RRT replaces it
+
+cRatingTables RatingTables;
+
+
+// Region 1 (US), see CEA-766
+static const char* const usDimensions[][10] = {
+  { "Entire Audience", "", "None", "TV-G", "TV-PG", "TV-14", "TV-MA", NULL },
+  { "Dialogue",        "", "D", NULL },
+  { "Language",        "", "L", NULL },
+  { "Sex",             "", "S", NULL },
+  { "Violence",        "", "V", NULL },
+  { "Children",        "", "TV-Y", "TV-Y7", NULL },
+  { "Fantasy violence","", "FV", NULL },
+  { "MPAA",            "", "N/A", "G", "PG", "PG-13", "R", "NC-17", "X", "NR" }
+};
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+cRatingTables::cRatingTables(void)
+{
+  memset(regions, 0, sizeof(regions));
+  
+  RatingRegion* us = new RatingRegion;
+  us->region = 1;
+  us->version = BUILT_IN_VERSION;
+  us->name = us->AddString("US (50 states + possessions)");
+  
+  for (unsigned int i=0; i<sizeof(usDimensions)/sizeof(usDimensions[0]); i++)
+  {
+    RatingRegion::Dimension dim;
+    memset(&dim, 0, sizeof(dim));
+    dim.name = us->AddString(usDimensions[i][0]);
+    dim.graduatedScale = (i == 0 || i == 5 || i == 7);
+    for (int j=1; j<10 && usDimensions[i][j]; j++) {
+      dim.abbrev[j-1] = dim.text[j-1] = us->AddString(usDimensions[i][j]);
+      dim.numValues = j;
+    }
+    us->dimensions.push_back(dim);
+  }
+  
+  regions[1] = us;
+}
+
+
+//----------------------------------------------------------------------------
+
+cRatingTables::~cRatingTables()
+{
+  for (int i=0; i<256; i++)
+    delete regions[i];
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cRatingTables::Has(u8 region, u8 version)
+{
+  cMutexLock lock(&mutex);
+  return regions[region] && regions[region]->version == version;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cRatingTables::Put(const RatingRegion& region)
+{
+  RatingRegion* r = new RatingRegion(region);
+  
+  cMutexLock lock(&mutex);
+  delete regions[region.region];
+  regions[region.region] = r;
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cRatingTables::GetRating(const EventAttributes& attributes, std::string& system, std::string& rating)
+{
+  cMutexLock lock(&mutex);
+  
+  const RatingRegion* r = regions[attributes.ratingRegion];
+  if (!attributes.ratingRegion || !r)
+    return false;
+    
+  rating.clear();
+  for (u8 i=0; i<8 && i<r->dimensions.size(); i++)
+  {
+    const char* abbrev = r->Abbrev(i, attributes.Rating(i));
+    if (!*abbrev)
+      continue;
+    if (!rating.empty())
+      rating += " ";
+    rating += abbrev;
+  }
+  
+  system = r->String(r->name);
+  return !rating.empty();
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2006-2010 Alex Lasnier <alex@fepg.org>
+ *
+ * This file is part of ATSC EPG
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __ATSC_RATING_TABLES_H
+#define __ATSC_RATING_TABLES_H
+
+#include <string>
+
+#include <vdr/thread.h>
+
+#include "structs.h"
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+// Rating regions received in RRTs, indexed by region. Region 1 (US) is not
+// broadcast and is built in.
+class cRatingTables
+{
+public:
+  cRatingTables(void);
+  ~cRatingTables();
+  
+  bool Has(u8 region, u8 version);
+  void Put(const RatingRegion& region);
+  
+  // Abbreviated ratings of an event, e.g. "TV-PG D L"
+  bool GetRating(const EventAttributes& attributes, std::string& system, std::string& rating);
+  
+private:
+  RatingRegion* regions[256];
+  cMutex mutex;
+};
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+extern cRatingTables RatingTables;
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+#endif //__ATSC_RATING_TABLES_H
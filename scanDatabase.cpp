@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2006-2010 Alex Lasnier <alex@fepg.org>
+ *
+ * This file is part of ATSC EPG
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "scanDatabase.h"
+#include "tools.h"
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+cScanDatabase ScanDatabase;
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+cScanDatabase::cScanDatabase(void)
+{
+}
+
+
+//----------------------------------------------------------------------------
+
+// One "F" line per frequency:
+//   F modulation frequency locked tsid vctVersion strength quality checked
+// followed by its channels, each on a "C" line in channels.conf format.
+bool cScanDatabase::Load(const char* FileName)
+{
+  cMutexLock lock(&mutex);
+  
+  fileName = FileName;
+  entries.clear();
+  
+  FILE* f = fopen(fileName, "r");
+  if (!f)
+    return false;
+    
+  Entry* entry = NULL;
+  cReadLine reader;
+  char* line;
+  while ((line = reader.Read(f)) != NULL)
+  {
+    int modulation, frequency, locked, tsid, vctVersion, strength, quality;
+    long checked;
+    
+    if (line[0] == 'F' && sscanf(line + 1, "%d %d %d %d %d %d %d %ld", &modulation, &frequency, &locked, 
+                                 &tsid, &vctVersion, &strength, &quality, &checked) == 8) 
+    {
+      entry = &entries[Key(modulation, frequency)];
+      entry->locked = locked;
+      entry->tsid = tsid;
+      entry->vctVersion = vctVersion;
+      entry->strength = strength;
+      entry->quality = quality;
+      entry->checked = checked;
+      entry->channels.clear();
+    }
+    else if (line[0] == 'C' && line[1] == ' ' && entry) {
+      entry->channels += line + 2;
+      entry->channels += "\n";
+    }
+  }
+  
+  fclose(f);
+  dprint(L_DBG, "Scan database: loaded %d frequencies.", (int) entries.size());
+  return true;
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cScanDatabase::Save(void)
+{
+  cMutexLock lock(&mutex);
+  
+  if (!*fileName)
+    return false;
+    
+  cString tmpName = cString::sprintf("%s.new", *fileName);
+  FILE* f = fopen(tmpName, "w");
+  if (!f) {
+    dprint(L_ERR, "Scan database: cannot create %s.", *tmpName);
+    return false;
+  }
+  
+  for (std::map<uint64_t, Entry>::const_iterator i = entries.begin(); i != entries.end(); i++)
+  {
+    const Entry& e = i->second;
+    fprintf(f, "F %d %d %d %d %d %d %d %ld\n", int(i->first >> 32), int(i->first & 0xFFFFFFFF), e.locked, 
+            e.tsid, e.vctVersion, e.strength, e.quality, (long) e.checked);
+    
+    size_t start = 0, end;
+    while ((end = e.channels.find('\n', start)) != std::string::npos) {
+      fprintf(f, "C %s\n", e.channels.substr(start, end - start).c_str());
+      start = end + 1;
+    }
+  }
+  
+  bool ok = fflush(f) == 0 && fsync(fileno(f)) == 0;
+  if (fclose(f) != 0)
+    ok = false;
+    
+  if (!ok || rename(tmpName, fileName) < 0) {
+    dprint(L_ERR, "Scan database: cannot write %s.", *fileName);
+    unlink(tmpName);
+    return false;
+  }
+  
+  return true;
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cScanDatabase::Get(int modulation, int frequency, Entry& entry)
+{
+  cMutexLock lock(&mutex);
+  
+  std::map<uint64_t, Entry>::const_iterator i = entries.find(Key(modulation, frequency));
+  if (i == entries.end())
+    return false;
+    
+  entry = i->second;
+  return true;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cScanDatabase::Put(int modulation, int frequency, const Entry& entry)
+{
+  cMutexLock lock(&mutex);
+  entries[Key(modulation, frequency)] = entry;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2006-2010 Alex Lasnier <alex@fepg.org>
+ *
+ * This file is part of ATSC EPG
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __ATSC_SCAN_DATABASE_H
+#define __ATSC_SCAN_DATABASE_H
+
+#include <map>
+#include <string>
+
+#include <vdr/thread.h>
+#include <vdr/tools.h>
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+// The result of the last scan of each frequency, kept in scan.db so that a
+// rescan only has to look at what has changed.
+class cScanDatabase
+{
+public:
+  struct Entry {
+    Entry(void) : locked(false), tsid(-1), vctVersion(-1), strength(0), quality(0), checked(0) {}
+    
+    bool locked;
+    int tsid;       // -1 if unknown
+    int vctVersion; // -1 if there was no VCT
+    int strength;   // As reported by the frontend
+    int quality;    // SNR as reported by the frontend
+    time_t checked;
+    std::string channels; // channels.conf lines
+  };
+  
+  cScanDatabase(void);
+  
+  bool Load(const char* FileName);
+  bool Save(void);
+  
+  bool Get(int modulation, int frequency, Entry& entry);
+  void Put(int modulation, int frequency, const Entry& entry);
+  
+private:
+  static uint64_t Key(int modulation, int frequency) { return ((uint64_t) modulation << 32) | (uint32_t) frequency; }
+  
+  cString fileName;
+  std::map<uint64_t, Entry> entries;
+  cMutex mutex;
+};
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+extern cScanDatabase ScanDatabase;
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+#endif //__ATSC_SCAN_DATABASE_H
@@ -18,6 +18,8 @@
  */
 
 #include <stdarg.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
 #include <algorithm>
 
 #include <linux/dvb/frontend.h>
@@ -33,16 +35,30 @@
 #include "tables.h"
 #include "structs.h"
 #include "frequencies.h"
+#include "scanDatabase.h"
+#include "numbering.h"
+#include "filterManager.h"
 
 
 //////////////////////////////////////////////////////////////////////////////
 
 
-#define TIMEOUT        1000
-#define FILTER_TIMEOUT 5000
+#define TIMEOUT        1000 // ms, for a lock once there is a signal
+#define SIGNAL_TIMEOUT 150  // ms, for a signal after tuning
+#define LOCK_POLL      10   // ms
+#define STOP_TIMEOUT   10   // s, for the scan thread and its workers to end
+#define MIN_DWELL      1500 // ms, without any sign of more tables to come
+#define MAX_DWELL      10000
+#define DWELL_STEP     250
 #define FILE_NAME      "channels.conf"
+#define DATABASE_NAME  "scan.db"
+#define EMPTY_RECHECK  (30 * 24 * 3600) // s, between probes of an empty frequency
+#define HARVEST_SETTLE 10   // s, for the MGT to show whether the guide is current
+#define HARVEST_POLL   1000 // ms
+#define MAX_HARVEST    600  // s, per transponder
 
 static const char* const ignoreEncStrings[2] = { "Include encrypted", "Ignore encrypted" };
+static const char* const modeStrings[2] = { "Full", "Incremental" };
 
 
 //////////////////////////////////////////////////////////////////////////////
@@ -54,17 +70,15 @@ cATSCScanner::cATSCScanner(void) : cOsdMenu("ATSC Channel Scan", 12),
   dprint(L_DBGV, "ATSC Scanner Created.");
   SetHelp("Cancel");
   
-  Set(0x1FFB, 0xC8, 0xFE); // VCT-T/C
-  
   dir = cPlugin::ConfigDirectory("atscepg");
-  asprintf(&numberCmd, "%s/number", dir);
-  
   file = NULL;
   deviceNum = 0;
   modulation = 0;
-  currentFrequency = 0;
+  nextProbe = probesDone = nextDwell = 0;
   devSelection = true;
   ignoreEncrypted = true;
+  incremental = false;
+  harvestTime = 0;
   
   if (AtscDevices.NumDevices() == 0) {
     devSelection = false;
@@ -75,9 +89,15 @@ cATSCScanner::cATSCScanner(void) : cOsdMenu("ATSC Channel Scan", 12),
     int n = AtscDevices.NumDevices();
     for (int i=0; i<n; i++)
       deviceNames[i] = AtscDevices.GetName(i);
+    if (n > 1) {
+      deviceNames[n++] = "All free devices";
+      deviceNum = n - 1;
+    }
     cOsdMenu::Add(new cMenuEditStraItem("Device", &deviceNum, n, deviceNames));
     cOsdMenu::Add(new cMenuEditStraItem("Modulation", &modulation, NUM_FREQ_TYPES, Frequencies_Name));
     cOsdMenu::Add(new cMenuEditStraItem("Channels", &ignoreEncrypted, 2, ignoreEncStrings));
+    cOsdMenu::Add(new cMenuEditStraItem("Scan", &incremental, 2, modeStrings));
+    cOsdMenu::Add(new cMenuEditIntItem("Harvest guide (s)", &harvestTime, 0, MAX_HARVEST, "No"));
     cOsdMenu::Add(new cOsdItem("Start scan..."));
   }
 
@@ -89,8 +109,9 @@ cATSCScanner::cATSCScanner(void) : cOsdMenu("ATSC Channel Scan", 12),
 
 cATSCScanner::~cATSCScanner(void) 
 {
-  Cancel(TIMEOUT+500);
-  free(numberCmd);
+  Cancel(-1);
+  resultWait.Signal();
+  Cancel(STOP_TIMEOUT);
   
   dprint(L_DBGV, "ATSC Scanner Destroyed.");
 }
@@ -102,90 +123,509 @@ void cATSCScanner::Action(void)
 {
   dprint(L_DBG, "ATSC Scanner thread started.");
   
+  ChannelNumbering.Reload();
+  
+  // One worker on the selected device, or on each device not recording
+  int prevChan = -1;
+  std::vector<cScanWorker*> workers;
+  for (int i=0; i<AtscDevices.NumDevices(); i++)
+  {
+    cDevice* device = AtscDevices.GetDevice(i);
+    if (deviceNum < AtscDevices.NumDevices() ? i != deviceNum : device->Receiving(true))
+      continue;
+    if (device == cDevice::ActualDevice())
+      prevChan = cDevice::CurrentChannel();
+    workers.push_back(new cScanWorker(this, i));
+  }
+  
+  if (workers.empty()) {
+    AddLine("No free ATSC device");
+    return;
+  }
+  
   char* fn = NULL;
   asprintf(&fn, "%s/%s", dir, FILE_NAME);
   file = fopen(fn, "w");
   free(fn);
   if (!file) {
     AddLine("Could not open output file.");
+    for (size_t i=0; i<workers.size(); i++)
+      delete workers[i];
     return;
   }
-   
-  cChannel* c = new cChannel();
-  cDevice* device = AtscDevices.GetDevice(deviceNum);
-  const int* frequencies = Frequencies_List[modulation];
-  unsigned int frequenciesNum = Frequencies_Size[modulation];
   
-  bool doPMTscan = (modulation == 1);
+  ScanDatabase.Load(AddDirectory(dir, DATABASE_NAME));
   
-  if (doPMTscan)
-    Set(0x0000, 0x00); // Do PAT/PMT scan for cable
+  results.assign(Frequencies_Size[modulation], cScanWorker::Result());
+  nextProbe = probesDone = nextDwell = 0;
+  time_t now = time(NULL);
+  for (size_t i=0; i<results.size(); i++)
+  {
+    cScanWorker::Result& r = results[i];
+    r.done = r.skipped = r.locked = false;
+    r.tsid = r.vctVersion = -1;
+    r.strength = r.quality = 0;
+    
+    // An incremental scan rarely looks at frequencies that were empty
+    cScanDatabase::Entry entry;
+    if (incremental && ScanDatabase.Get(modulation, Frequencies_List[modulation][i], entry) &&
+        !entry.locked && now - entry.checked < EMPTY_RECHECK) {
+      r.done = r.skipped = true;
+      probesDone++;
+    }
+  }
   
-  int prevChan = -1;
-  if (device == cDevice::ActualDevice())
-    prevChan = cDevice::CurrentChannel();
-
-  for (uint32_t i=0; i<frequenciesNum && Running(); i++)
+  if (workers.size() > 1)
+    AddLine("Scanning with %d devices", (int) workers.size());
+  for (size_t i=0; i<workers.size(); i++)
+    workers[i]->Start();
+    
+  // Show the results in frequency order as they come in
+  size_t shown = 0;
+  while (shown < results.size())
   {
-    currentFrequency = frequencies[i];
-    SetTransponderData(c);
+    {
+      cMutexLock lock(&mutex);
+      for (; shown < results.size() && results[shown].done; shown++) 
+      {
+        const cScanWorker::Result& r = results[shown];
+        for (size_t l=0; l<r.lines.size(); l++)
+          AddLine("%s", r.lines[l].c_str());
+        fputs(r.channels.c_str(), file);
+      }
+    }
+    if (shown == results.size() || !Running())
+      break;
+    resultWait.Wait(500);
+  }
+  
+  // Stop them all at once, then wait for each
+  for (size_t i=0; i<workers.size(); i++)
+    workers[i]->Stop();
+  for (size_t i=0; i<workers.size(); i++)
+    delete workers[i];
+  
+  AddLine("Saved to file: %s", FILE_NAME);  
+  fclose(file);
+  ScanDatabase.Save();
+
+  if (prevChan > 0)
+    Channels.SwitchTo(prevChan);
+  
+  dprint(L_DBG, "ATSC Scanner thread ended.");
+}
+
+
+//----------------------------------------------------------------------------
+
+cScanWorker::Result* cATSCScanner::NextFrequency(int& frequency, bool& probe)
+{
+  cMutexLock lock(&mutex);
+  
+  while (nextProbe < results.size() && results[nextProbe].skipped)
+    nextProbe++;
+  probe = nextProbe < results.size();
+  if (probe) {
+    frequency = Frequencies_List[modulation][nextProbe];
+    return &results[nextProbe++];
+  }
+  
+  // The second pass starts once every frequency has been probed
+  while (probesDone < results.size() && Running())
+    probed.TimedWait(mutex, 100);
     
-    AddLine("Tuning:\t%d Hz", frequencies[i]);
+  while (nextDwell < results.size() && !results[nextDwell].locked)
+    nextDwell++;
+  if (nextDwell >= results.size() || !Running())
+    return NULL;
     
-    device->SwitchChannel(c, false);
-    bool lock = device->HasLock(TIMEOUT); 
-    if (!lock) {
-      UpdateLastLine("Failed");
-      dprint(L_DBG, "Tuning: %d Hz (Failed)", frequencies[i]);
-      continue; 
+  frequency = Frequencies_List[modulation][nextDwell];
+  return &results[nextDwell++];
+}
+
+
+//----------------------------------------------------------------------------
+
+int cATSCScanner::Frequency(const cScanWorker::Result* result)
+{
+  return Frequencies_List[modulation][result - &results[0]];
+}
+
+
+//----------------------------------------------------------------------------
+
+// Another frequency of this scan that carries the same transport stream, 
+// e.g. a translator, and whose PMTs have already been read
+const cScanWorker::Result* cATSCScanner::FindTsid(int tsid, const cScanWorker::Result* except)
+{
+  cMutexLock lock(&mutex);
+  
+  for (size_t i=0; i<results.size(); i++)
+    if (&results[i] != except && results[i].done && results[i].tsid == tsid && !results[i].pmtChannels.empty())
+      return &results[i];
+      
+  return NULL;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cATSCScanner::Finished(cScanWorker::Result* result, bool probe)
+{
+  {
+    cMutexLock lock(&mutex);
+    if (probe) {
+      probesDone++;
+      probed.Broadcast();
     }
+    result->done = !probe || !result->locked;
+  }
+  
+  if (result->done) 
+  {
+    cScanDatabase::Entry entry;
+    entry.locked = result->locked;
+    entry.tsid = result->tsid;
+    entry.vctVersion = result->vctVersion;
+    entry.strength = result->strength;
+    entry.quality = result->quality;
+    entry.checked = time(NULL);
+    entry.channels = result->channels;
+    ScanDatabase.Put(modulation, Frequency(result), entry);
+  }
+  resultWait.Signal();
+}
+
+
+//----------------------------------------------------------------------------
+
+eOSState cATSCScanner::ProcessKey(eKeys Key)
+{
+  eOSState state = cOsdMenu::ProcessKey(Key);
 
-    UpdateLastLine("Success");
-    dprint(L_DBG, "Tuning: %d Hz (Success)", frequencies[i]);
-     
-    gotVCT = false;
-    gotPAT = false;
-    gotPMT = doPMTscan ? false : true;
+  if (state == osUnknown)
+  {
+    state = osContinue;
+
+    switch (Key)
+    {
+      case kBack:
+        state = osBack;
+        break;
+        
+      case kOk:
+        if (devSelection && Current() == 5) {
+          devSelection = false;
+          Clear();
+          SetCols(10, 16, 10);
+          Display();
+          Start();
+        }
+        break;        
+        
+      case kRed:
+        if (Running()) {
+          Cancel(-1);
+          resultWait.Signal();
+          Cancel(STOP_TIMEOUT);
+          AddLine("Scan cancelled");
+          dprint(L_DBG, "Scan cancelled");
+          state = osContinue;
+        }
+        else
+          state = osBack;
+        break;
+       
+      default:
+        break;    
+    }
+  }
     
-    device->AttachFilter(this);
-    condWait.Wait(FILTER_TIMEOUT); // Let the filter do its thing
-    device->Detach(this);
+  return state;  
+}
+
+
+//----------------------------------------------------------------------------
+
+void cATSCScanner::AddLine(const char* Text, ...) 
+{
+  char* buffer = NULL;
+  va_list ap;
+  va_start(ap, Text);
+  vasprintf(&buffer, Text, ap);
+  va_end(ap);
+
+  cOsdItem* item = new cOsdItem(buffer);
+  free(buffer);
+
+  cOsdMenu::Add(item);
+  CursorDown();
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+cScanWorker::cScanWorker(cATSCScanner* Scanner, int Device) : 
+                         cThread(*cString::sprintf("ATSC Scanner %d", Device))
+{
+  scanner = Scanner;
+  device = AtscDevices.GetDevice(Device);
+  result = NULL;
+  currentFrequency = 0;
+  tsid = 0;
+  gotPAT = gotVCT = gotPMT = gotMGT = expectVCT = false;
+  numProgress = 0;
+  
+  // The frontend's status tells early on whether there is a signal at all
+  frontend = -1;
+  if (AtscDevices.GetAdapter(Device) >= 0)
+    frontend = open(*cString::sprintf("/dev/dvb/adapter%d/frontend0", AtscDevices.GetAdapter(Device)), O_RDONLY | O_NONBLOCK);
+  
+  Set(0x1FFB, 0xC8, 0xFE); // VCT-T/C
+  Set(0x1FFB, 0xC7);       // MGT
+  
+  if (scanner->modulation == 1)
+    Set(0x0000, 0x00); // Do PAT/PMT scan for cable
+}
+
+
+//----------------------------------------------------------------------------
+
+cScanWorker::~cScanWorker()
+{
+  Stop();
+  Cancel(3);
+  if (frontend >= 0)
+    close(frontend);
+}
+
+
+//----------------------------------------------------------------------------
+
+// Only asks the thread to stop, the destructor waits for it
+void cScanWorker::Stop(void)
+{
+  Cancel(-1);
+  condWait.Signal(); // If we are waiting for a VCT, stop.
+}
+
+
+//----------------------------------------------------------------------------
+
+void cScanWorker::Action(void)
+{
+  cChannel* c = new cChannel();
+  bool probe;
+  
+  while (Running() && (result = scanner->NextFrequency(currentFrequency, probe)))
+  {
+    SetTransponderData(c);
     
-    if ((!gotVCT && !doPMTscan) || (!gotVCT && !gotPMT)) {
-      AddLine("\tNo channels found");
-      dprint(L_DBG, "No channels found");
+    if (probe) {
+      result->locked = Probe(c);
+      AddLine("Tuning:\t%d Hz\t%s", currentFrequency, result->locked ? "Success" : "Failed");
+      dprint(L_DBG, "Tuning: %d Hz (%s)", currentFrequency, result->locked ? "Success" : "Failed");
     }
-  }  
+    else
+      Dwell(c);
+    
+    scanner->Finished(result, probe);
+  }
+  
   delete c;
+}
 
-  AddLine("Saved to file: %s", FILE_NAME);  
-  fclose(file);
 
-  if (prevChan > 0)
-    Channels.SwitchTo(prevChan);
+//----------------------------------------------------------------------------
+
+// Tunes and waits for a lock. Gives up after SIGNAL_TIMEOUT if the frontend 
+// does not even see a carrier.
+bool cScanWorker::Probe(cChannel* c)
+{
+  device->SwitchChannel(c, false);
   
-  dprint(L_DBG, "ATSC Scanner thread ended.");
+  cTimeMs timer;
+  while (timer.Elapsed() < TIMEOUT && Running())
+  {
+    if (device->HasLock(0)) {
+      ReadSignal();
+      return true;
+    }
+      
+    fe_status_t status;
+    if (frontend >= 0 && timer.Elapsed() >= SIGNAL_TIMEOUT && ioctl(frontend, FE_READ_STATUS, &status) == 0 
+        && !(status & (FE_HAS_SIGNAL | FE_HAS_CARRIER)))
+      return false;
+      
+    cCondWait::SleepMs(LOCK_POLL);
+  }
+  
+  if (!device->HasLock(0))
+    return false;
+    
+  ReadSignal();
+  return true;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cScanWorker::ReadSignal(void)
+{
+  uint16_t value;
+  if (frontend >= 0 && ioctl(frontend, FE_READ_SIGNAL_STRENGTH, &value) == 0)
+    result->strength = value;
+  if (frontend >= 0 && ioctl(frontend, FE_READ_SNR, &value) == 0)
+    result->quality = value;
+}
+
+
+//----------------------------------------------------------------------------
+
+// In an incremental scan, a VCT with the TSID and version of the last scan
+// means the channels of the frequency are still the same.
+bool cScanWorker::Unchanged(const u_char* Data)
+{
+  cScanDatabase::Entry entry;
+  if (!scanner->incremental || !ScanDatabase.Get(scanner->modulation, currentFrequency, entry) || entry.vctVersion < 0)
+    return false;
+    
+  if (VCTChannelMap::ExtractTID(Data) != entry.tsid || PSIPTable::ExtractVersion(Data) != entry.vctVersion)
+    return false;
+    
+  result->tsid = entry.tsid;
+  result->vctVersion = entry.vctVersion;
+  result->channels = entry.channels;
+  AddLine("\tUnchanged (TSID %d, VCT version %d)", entry.tsid, entry.vctVersion);
+  return true;
+}
+
+
+//----------------------------------------------------------------------------
+
+// Reads the tables until the VCT, PAT and PMTs are in. After MIN_DWELL it 
+// only keeps waiting while tables not seen before are still coming in (the
+// repeats of the PAT, MGT and VCT do not count) or the MGT lists a VCT that 
+// has not been received yet.
+void cScanWorker::Dwell(cChannel* c)
+{
+  // The guide acquisition filter only runs on numbered channels, unless the
+  // transponder is being harvested
+  if (scanner->harvestTime)
+    FilterManager.SetScanHarvest(c->Transponder(), true);
+    
+  device->SwitchChannel(c, false);
+  if (!device->HasLock(TIMEOUT)) {
+    AddLine("\tLost lock");
+    FilterManager.SetScanHarvest(c->Transponder(), false);
+    return;
+  }
+  
+  bool doPMTscan = (scanner->modulation == 1);
+  gotVCT = false;
+  gotPAT = false;
+  gotPMT = doPMTscan ? false : true;
+  gotMGT = expectVCT = false;
+  numProgress = 0;
+  
+  device->AttachFilter(this);
+  
+  cTimeMs timer;
+  int lastProgress = 0;
+  while (!(gotVCT && gotPMT) && timer.Elapsed() < MAX_DWELL && Running())
+  {
+    condWait.Wait(DWELL_STEP);
+    
+    bool arriving = numProgress != lastProgress;
+    lastProgress = numProgress;
+    if (gotMGT && !expectVCT && gotPMT)
+      break;
+    if (timer.Elapsed() >= MIN_DWELL && !arriving && !(gotMGT && expectVCT && !gotVCT))
+      break;
+  }
+  
+  device->Detach(this);
+  
+  if ((!gotVCT && !doPMTscan) || (!gotVCT && !gotPMT)) {
+    AddLine("\tNo channels found");
+    dprint(L_DBG, "No channels found");
+  }
+  else if (gotVCT && scanner->harvestTime)
+    Harvest(c->Transponder(), timer.Elapsed() / 1000);
+    
+  FilterManager.SetScanHarvest(c->Transponder(), false);
+}
+
+
+//----------------------------------------------------------------------------
+
+// Stays tuned while the acquisition filter reads the guide, until the 
+// tables listed in the MGT are in or the time per transponder is used up. 
+// The events go to the PSIP cache, and to the schedules of channels VDR 
+// already knows.
+void cScanWorker::Harvest(int transponder, int elapsed)
+{
+  time_t start = time(NULL) - elapsed;
+  
+  while (Running())
+  {
+    int seconds = time(NULL) - start;
+    
+    if (FilterManager.LastAcquired(transponder) >= start) {
+      AddLine("\tGuide acquired in %ds", seconds);
+      break;
+    }
+    // Same MGT version as acquired before, the guide is current
+    if (seconds >= HARVEST_SETTLE && FilterManager.GetMgtVersion(transponder) >= 0 && FilterManager.PendingBytes(transponder) == 0) {
+      AddLine("\tGuide up to date");
+      break;
+    }
+    if (seconds >= scanner->harvestTime) {
+      AddLine("\tGuide incomplete after %ds", seconds);
+      break;
+    }
+      
+    condWait.Wait(HARVEST_POLL);
+  }
+  
+  dprint(L_DBG, "Scan harvest of transponder %d ended after %ds.", transponder, int(time(NULL) - start));
 }
 
 
 //----------------------------------------------------------------------------
 
-void cATSCScanner::Process(u_short Pid, u_char Tid, const u_char* Data, int Length)
+void cScanWorker::Process(u_short Pid, u_char Tid, const u_char* Data, int Length)
 {
   switch (Tid)
   {
     case 0x00:
-      if (!gotPAT)
+      if (!gotPAT) {
         ProcessPAT(Data, Length);
+        numProgress += gotPAT;
+      }
       break;
     case 0x02:
-      if (ProcessPMT(Data, Length))
+      if (ProcessPMT(Data, Length)) {
         cFilter::Del(Pid, 0x02);
+        numProgress++;
+      }
+      break;
+    case 0xC7:
+      if (!gotMGT) {
+        ProcessMGT(Data, Length);
+        numProgress += gotMGT;
+      }
       break;
     case 0xC8:
     case 0xC9:
-      if (!gotVCT)
+      if (gotVCT)
+        break;
+      if (Unchanged(Data))
+        gotVCT = gotPMT = true;
+      else
         ProcessVCT(Tid, Data, Length);
+      numProgress++;
       break;
   }
 
@@ -196,7 +636,22 @@ void cATSCScanner::Process(u_short Pid, u_char Tid, const u_char* Data, int Leng
 
 //----------------------------------------------------------------------------
 
-void cATSCScanner::ProcessVCT(u_char Tid, const u_char* Data, int Length)
+void cScanWorker::ProcessMGT(const u_char* Data, int Length)
+{
+  MGT mgt(Data, Length);
+  if (!mgt.CheckCRC())
+    return;
+    
+  for (int k=0; k<mgt.NumberOfTables(); k++)
+    if (mgt.GetTable(k)->table_type <= 0x0003) // Terrestrial or cable VCT
+      expectVCT = true;
+  gotMGT = true;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cScanWorker::ProcessVCT(u_char Tid, const u_char* Data, int Length)
 {  
   gotVCT = true;
   
@@ -209,6 +664,8 @@ void cATSCScanner::ProcessVCT(u_char Tid, const u_char* Data, int Length)
     return;
   }
   
+  result->tsid = vct.TID();
+  result->vctVersion = vct.Version();
   AddLine("\tReceived VCT: found %d channels.", vct.NumberOfChannels());
   dprint(L_DBG, "Received VCT-%c found %d channels.", Tid==0xC8?'T':'C', vct.NumberOfChannels());
 
@@ -221,31 +678,52 @@ void cATSCScanner::ProcessVCT(u_char Tid, const u_char* Data, int Length)
     AddLine("\t%d.%d  %s", ch->MajorNumber(), ch->MinorNumber(), ch->ShortName());
     dprint(L_DBG, "  %d.%d  %s", ch->MajorNumber(), ch->MinorNumber(), ch->ShortName());
     
-    if (file)
-    {
-      int chanNum = Number(ch->MajorNumber(), ch->MinorNumber());
-      if (chanNum == -1)
-        continue;
+    int chanNum = ChannelNumbering.Number(ch->MajorNumber(), ch->MinorNumber());
+    if (chanNum == -1)
+      continue;
 
-      cString chanText = ch->VDRChannel()->ToText();
-      if (chanNum)
-        fprintf(file, ":@%d\n%s", chanNum, *chanText);
-      else
-        fprintf(file, "%s", *chanText);
-    }
+    cString chanText = ch->VDRChannel()->ToText();
+    if (chanNum)
+      result->channels += *cString::sprintf(":@%d\n%s", chanNum, *chanText);
+    else
+      result->channels += *chanText;
   }
 }
 
 
 //----------------------------------------------------------------------------
 
-void cATSCScanner::ProcessPAT(const u_char* data, int Length)
+void cScanWorker::ProcessPAT(const u_char* data, int Length)
 {
   SI::PAT pat(data, false);
   if (!pat.CheckCRCAndParse())
     return;
   
   tsid = pat.getTransportStreamId();
+  if (result->tsid < 0)
+    result->tsid = tsid;
+  gotPAT = true;
+  
+  // The PMTs of a transport stream also carried on another frequency (e.g. 
+  // by a translator) are already known, only the transponder differs
+  if (const Result* other = scanner->FindTsid(tsid, result)) {
+    std::string lines = other->pmtChannels;
+    for (size_t pos = 0, end; pos < lines.size(); pos = end + 1) {
+      end = lines.find('\n', pos);
+      if (end == std::string::npos)
+        end = lines.size();
+      cChannel channel;
+      if (!channel.Parse(lines.substr(pos, end - pos).c_str()))
+        continue;
+      SetTransponderData(&channel);
+      cString text = channel.ToText();
+      result->channels += *text;
+      result->pmtChannels += *text;
+    }
+    AddLine("\tSame transport stream as %d Hz, skipping PMTs.", scanner->Frequency(other));
+    gotPMT = true;
+    return;
+  }
   
   pmtSIDs.clear();
   int numChan = 0;
@@ -259,13 +737,11 @@ void cATSCScanner::ProcessPAT(const u_char* data, int Length)
   
   AddLine("\tReceived PAT: found %d channels.", numChan);
   dprint(L_DBG, "Received PAT: found %d channels.", numChan);
-  
-  gotPAT = true;
 }
 
 //----------------------------------------------------------------------------
 
-bool cATSCScanner::ProcessPMT(const u_char* data, int Length)
+bool cScanWorker::ProcessPMT(const u_char* data, int Length)
 {
   SI::PMT pmt(data, false);
   if (!pmt.CheckCRCAndParse())
@@ -351,7 +827,7 @@ bool cATSCScanner::ProcessPMT(const u_char* data, int Length)
     }
   } 
   
-  if (!ignoreEncrypted || NumCaIds == 0)
+  if (!scanner->ignoreEncrypted || NumCaIds == 0)
   {
     cChannel channel;
     SetTransponderData(&channel);
@@ -362,8 +838,9 @@ bool cATSCScanner::ProcessPMT(const u_char* data, int Length)
     channel.SetPids(Vpid, Ppid, Vtype, Apids, Atypes, ALangs, Dpids, Dtypes, DLangs, Spids, SLangs, 0);
 #endif
     channel.SetCaIds(CaIds);
-    if (file)
-      fprintf(file, "%s", *(channel.ToText()));
+    cString text = channel.ToText();
+    result->channels += *text;
+    result->pmtChannels += *text;
   }
     
   pmtSIDs.erase(itr);
@@ -377,10 +854,10 @@ bool cATSCScanner::ProcessPMT(const u_char* data, int Length)
 
 //----------------------------------------------------------------------------
 
-void cATSCScanner::SetTransponderData(cChannel* c)
+void cScanWorker::SetTransponderData(cChannel* c)
 {
   cDvbTransponderParameters dtp;
-  dtp.SetModulation((modulation == 0) ? VSB_8 : QAM_256);
+  dtp.SetModulation((scanner->modulation == 0) ? VSB_8 : QAM_256);
   dtp.SetInversion(INVERSION_AUTO);    
   c->SetTransponderData(cSource::stAtsc, currentFrequency, 0, dtp.ToString('A'));
 }
@@ -388,54 +865,7 @@ void cATSCScanner::SetTransponderData(cChannel* c)
 
 //----------------------------------------------------------------------------
 
-eOSState cATSCScanner::ProcessKey(eKeys Key)
-{
-  eOSState state = cOsdMenu::ProcessKey(Key);
-
-  if (state == osUnknown)
-  {
-    state = osContinue;
-
-    switch (Key)
-    {
-      case kBack:
-        state = osBack;
-        break;
-        
-      case kOk:
-        if (devSelection && Current() == 3) {
-          devSelection = false;
-          Clear();
-          SetCols(10, 16, 10);
-          Display();
-          Start();
-        }
-        break;        
-        
-      case kRed:
-        if (Running()) {
-          condWait.Signal(); // If we are waiting for a VCT, stop.
-          Cancel(TIMEOUT+500);
-          AddLine("Scan cancelled");
-          dprint(L_DBG, "Scan cancelled");
-          state = osContinue;
-        }
-        else
-          state = osBack;
-        break;
-       
-      default:
-        break;    
-    }
-  }
-    
-  return state;  
-}
-
-
-//----------------------------------------------------------------------------
-
-void cATSCScanner::AddLine(const char* Text, ...) 
+void cScanWorker::AddLine(const char* Text, ...) 
 {
   char* buffer = NULL;
   va_list ap;
@@ -443,68 +873,9 @@ void cATSCScanner::AddLine(const char* Text, ...)
   vasprintf(&buffer, Text, ap);
   va_end(ap);
 
-  cOsdItem* item = new cOsdItem(buffer);
+  result->lines.push_back(buffer);
   free(buffer);
-
-  cOsdMenu::Add(item);
-  CursorDown();
-}
-
-
-//----------------------------------------------------------------------------
-
-void cATSCScanner::UpdateLastLine(const char* Text)
-{
-  if (!Last())
-    return;
-
-  char* buffer = NULL;
-  asprintf(&buffer, "%s\t%s", Last()->Text(), Text);
-  Last()->SetText(buffer, false); // false, so we don't need to free(buffer)
-  DisplayCurrent(true);
-}
-
-
-//----------------------------------------------------------------------------
-
-int cATSCScanner::Number(uint16_t major, uint16_t minor)
-{  
-  char* result = NULL;
-  char* cmd = NULL;
-  int num = 0;
-  
-  asprintf(&cmd, "%s %d %d", numberCmd, major, minor);
-  
-  cPipe p;
-  if (p.Open(cmd, "r"))
-  {
-    int l = 0;
-    int c;
-    while ((c = fgetc(p)) != EOF) {
-      if (l % 20 == 0)
-        result = (char*) realloc(result, l + 21);
-      result[l++] = c;
-    }
-    p.Close();
-    
-    if (result) {
-      result[l] = 0;
-      num = atoi(result);
-    }
-    else
-      num = 0;
-      
-    free(result);
-  }
-  else
-    dprint(L_ERR, "ERROR: can't open pipe for command '%s'", cmd);
- 
-  free(cmd);
-  
-  return num;
 }
 
 
 //////////////////////////////////////////////////////////////////////////////
-
-
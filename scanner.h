@@ -21,6 +21,8 @@
 #define __ATSC_SCANNER_H
 
 #include <list>
+#include <string>
+#include <vector>
 
 #include <vdr/device.h>
 #include <vdr/filter.h>
@@ -30,44 +32,111 @@
 //////////////////////////////////////////////////////////////////////////////
 
 
-class cATSCScanner : public cOsdMenu, public cThread, public cFilter
+class cATSCScanner;
+
+// Scans the frequencies it takes from the scanner's work queue on one device
+class cScanWorker : public cThread, public cFilter
 {
 public:
-  cATSCScanner(void);
-  virtual ~cATSCScanner();
- 
-  virtual eOSState ProcessKey(eKeys Key);
- 
+  struct Result {
+    bool done;
+    bool skipped; // Known to be empty, not probed
+    bool locked;  // In the first pass
+    int tsid;
+    int vctVersion;
+    int strength;
+    int quality;
+    std::vector<std::string> lines; // For the OSD
+    std::string channels;           // For channels.conf
+    std::string pmtChannels;        // The part found in the PMTs
+  };
+  
+  cScanWorker(cATSCScanner* Scanner, int Device);
+  virtual ~cScanWorker();
+  
+  void Stop(void);
+  
 protected:
   virtual void Action(void);
   virtual void Process(u_short Pid, u_char Tid, const u_char *Data, int Length);
   
 private:
   void AddLine(const char* Text, ...); 
-  void UpdateLastLine(const char* Text);
-  int Number(uint16_t major, uint16_t minor);
   void SetTransponderData(cChannel* c);
+  bool Probe(cChannel* c);
+  void Dwell(cChannel* c);
+  void Harvest(int transponder, int elapsed);
   
+  void ReadSignal(void);
+  bool Unchanged(const u_char* Data);
+  
+  void ProcessMGT(const u_char* Data, int Length);
   void ProcessVCT(u_char Tid, const u_char* Data, int Length);
   void ProcessPAT(const u_char* Data, int Length);
   bool ProcessPMT(const u_char* Data, int Length);
   
+  cATSCScanner* scanner;
+  cDevice* device;
+  int frontend;
+  Result* result;
+  
   cCondWait condWait;
   bool gotPAT;
   bool gotVCT;
   bool gotPMT;
+  bool gotMGT;
+  bool expectVCT; // Listed in the MGT
+  volatile int numProgress; // Tables received for the first time
   int tsid;
   std::list<uint16_t> pmtSIDs;
+  int currentFrequency;
+};
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+class cATSCScanner : public cOsdMenu, public cThread
+{
+public:
+  cATSCScanner(void);
+  virtual ~cATSCScanner();
+ 
+  virtual eOSState ProcessKey(eKeys Key);
+ 
+protected:
+  virtual void Action(void);
+  
+private:
+  friend class cScanWorker;
+  
+  void AddLine(const char* Text, ...); 
+  
+  // Work queue shared by the workers
+  cScanWorker::Result* NextFrequency(int& frequency, bool& probe);
+  void Finished(cScanWorker::Result* result, bool probe);
+  int Frequency(const cScanWorker::Result* result);
+  const cScanWorker::Result* FindTsid(int tsid, const cScanWorker::Result* except);
   
   bool devSelection;
-  int currentFrequency;
   const char* dir;
-  char* numberCmd;
   FILE* file;
   int deviceNum;
   int modulation;
   int ignoreEncrypted;
-  const char* deviceNames[MAXDEVICES];
+  int incremental;
+  int harvestTime; // s per transponder, 0 to only read the channels
+  const char* deviceNames[MAXDEVICES + 1];
+  
+  // First a quick pass for a lock on every frequency, then a pass that 
+  // reads the tables on those that locked
+  std::vector<cScanWorker::Result> results; // In frequency order
+  size_t nextProbe;
+  size_t probesDone;
+  size_t nextDwell;
+  cMutex mutex;
+  cCondVar probed;
+  cCondWait resultWait;
 };
 
 
@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2006-2010 Alex Lasnier <alex@fepg.org>
+ *
+ * This file is part of ATSC EPG
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ctype.h>
+#include <string.h>
+#include <algorithm>
+
+#include "searchIndex.h"
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+static inline bool IsWordChar(unsigned char c)
+{
+  return isalnum(c) || c >= 0x80; // Keep multibyte characters
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+bool SearchQuery::Parse(const char* query)
+{
+  terms.clear();
+  phrases.clear();
+  
+  if (!query)
+    return false;
+    
+  const char* p = query;
+  while (*p)
+  {
+    if (*p == '"') 
+    {
+      const char* end = strchr(p + 1, '"');
+      std::string text(p + 1, end ? end - p - 1 : strlen(p + 1));
+      
+      std::vector<std::string> words;
+      cSearchIndex::Tokenize(text, words);
+      for (unsigned int i=0; i<words.size(); i++) {
+        Term t = { words[i], false };
+        terms.push_back(t);
+      }
+      if (words.size() > 1)
+        phrases.push_back(words);
+        
+      p = end ? end + 1 : p + 1 + text.size();
+    }
+    else if (IsWordChar(*p))
+    {
+      const char* start = p;
+      while (IsWordChar(*p))
+        p++;
+        
+      std::vector<std::string> words;
+      cSearchIndex::Tokenize(std::string(start, p - start), words);
+      Term t = { words[0], *p == '*' };
+      terms.push_back(t);
+    }
+    else
+      p++;
+  }
+  
+  return !terms.empty();
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+void cSearchIndex::Tokenize(const std::string& text, std::vector<std::string>& words)
+{
+  words.clear();
+  
+  std::string word;
+  for (unsigned int i=0; i<=text.size(); i++)
+  {
+    unsigned char c = (i < text.size()) ? text[i] : ' ';
+    if (IsWordChar(c))
+      word += tolower(c);
+    else if (!word.empty()) {
+      words.push_back(word);
+      word.clear();
+    }
+  }
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cSearchIndex::ContainsPhrase(const std::vector<std::string>& words, const std::vector<std::string>& phrase)
+{
+  return std::search(words.begin(), words.end(), phrase.begin(), phrase.end()) != words.end();
+}
+
+
+//----------------------------------------------------------------------------
+
+void cSearchIndex::Add(uint32_t id, const std::string& text)
+{
+  std::vector<std::string> words;
+  Tokenize(text, words);
+  std::sort(words.begin(), words.end());
+  words.erase(std::unique(words.begin(), words.end()), words.end());
+  
+  for (unsigned int i=0; i<words.size(); i++) 
+  {
+    std::vector<uint32_t>& ids = postings[words[i]];
+    std::vector<uint32_t>::iterator itr = std::lower_bound(ids.begin(), ids.end(), id);
+    if (itr == ids.end() || *itr != id)
+      ids.insert(itr, id);
+  }
+}
+
+
+//----------------------------------------------------------------------------
+
+void cSearchIndex::Remove(uint32_t id, const std::string& text)
+{
+  std::vector<std::string> words;
+  Tokenize(text, words);
+  
+  for (unsigned int i=0; i<words.size(); i++) 
+  {
+    PostingMap::iterator p = postings.find(words[i]);
+    if (p == postings.end())
+      continue;
+      
+    std::vector<uint32_t>& ids = p->second;
+    std::vector<uint32_t>::iterator itr = std::lower_bound(ids.begin(), ids.end(), id);
+    if (itr != ids.end() && *itr == id)
+      ids.erase(itr);
+    if (ids.empty())
+      postings.erase(p);
+  }
+}
+
+
+//----------------------------------------------------------------------------
+
+void cSearchIndex::Clear(void)
+{
+  postings.clear();
+}
+
+
+//----------------------------------------------------------------------------
+
+void cSearchIndex::Find(const SearchQuery::Term& term, std::vector<uint32_t>& ids) const
+{
+  ids.clear();
+  
+  if (!term.prefix) {
+    PostingMap::const_iterator p = postings.find(term.word);
+    if (p != postings.end())
+      ids = p->second;
+    return;
+  }
+  
+  for (PostingMap::const_iterator p = postings.lower_bound(term.word); p != postings.end(); p++) 
+  {
+    if (p->first.compare(0, term.word.size(), term.word) != 0)
+      break;
+    ids.insert(ids.end(), p->second.begin(), p->second.end());
+  }
+  
+  std::sort(ids.begin(), ids.end());
+  ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2006-2010 Alex Lasnier <alex@fepg.org>
+ *
+ * This file is part of ATSC EPG
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __ATSC_SEARCH_INDEX_H
+#define __ATSC_SEARCH_INDEX_H
+
+#include <map>
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+// A parsed search query: all terms must match. A term ending with '*' 
+// matches any word starting with it, words within double quotes must 
+// appear next to each other.
+struct SearchQuery
+{
+  struct Term {
+    std::string word;
+    bool prefix;
+  };
+  
+  bool Parse(const char* query);
+  
+  std::vector<Term> terms;
+  std::vector<std::vector<std::string> > phrases;
+};
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+// Inverted index from words to the ids of the strings containing them. 
+// The terms of a query are looked up one by one, so their ids can be mapped
+// to whatever uses the strings before intersecting.
+class cSearchIndex
+{
+public:
+  void Add(uint32_t id, const std::string& text);
+  void Remove(uint32_t id, const std::string& text);
+  void Clear(void);
+  
+  void Find(const SearchQuery::Term& term, std::vector<uint32_t>& ids) const;
+  int  Words(void) const { return postings.size(); }
+  
+  static void Tokenize(const std::string& text, std::vector<std::string>& words);
+  static bool ContainsPhrase(const std::vector<std::string>& words, const std::vector<std::string>& phrase);
+  
+private:
+  typedef std::map<std::string, std::vector<uint32_t> > PostingMap; // Sorted ids
+  PostingMap postings;
+};
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+#endif //__ATSC_SEARCH_INDEX_H
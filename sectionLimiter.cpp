@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2006-2010 Alex Lasnier <alex@fepg.org>
+ *
+ * This file is part of ATSC EPG
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <vdr/tools.h>
+
+#include "sectionLimiter.h"
+#include "stats.h"
+#include "tools.h"
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+// Sections per second. Even large multiplexes stay well below these.
+#define TABLE_RATE      150
+#define TABLE_BURST     300
+#define PID_RATE        300
+#define PID_BURST       600
+
+#define MIN_BACKOFF     1000  // ms
+#define MAX_BACKOFF     64000
+#define STORM_QUIET     60000 // ms without a storm before the back-off resets
+#define REPORT_INTERVAL 60000
+
+#define PID_KEY(pid) (0xFF000000 | (pid))
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+cSectionLimiter::cSectionLimiter(int FilterNum)
+{
+  filterNum = FilterNum;
+  lastReport = 0;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cSectionLimiter::Clear(void)
+{
+  buckets.clear();
+}
+
+
+//----------------------------------------------------------------------------
+
+// The table's bucket comes first so that a flood of one table does not use 
+// up the PID's share of the others
+bool cSectionLimiter::Allow(uint16_t pid, uint8_t tid)
+{
+  uint64_t now = cTimeMs::Now();
+  
+  if (now - lastReport >= REPORT_INTERVAL)
+    Report(now);
+    
+  if (!Take(buckets[((uint32_t) pid << 8) | tid], TABLE_RATE, TABLE_BURST, now) ||
+      !Take(buckets[PID_KEY(pid)], PID_RATE, PID_BURST, now)) {
+    Stats.Add(S_SECTIONS_DROPPED);
+    return false;
+  }
+  
+  return true;
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cSectionLimiter::Take(Bucket& b, int rate, int burst, uint64_t now)
+{
+  if (now < b.mutedUntil) {
+    b.dropped++;
+    return false;
+  }
+  
+  // rate tokens/s is rate thousandths/ms
+  if (b.tokens < 0)
+    b.tokens = burst * 1000;
+  else if (now > b.last)
+    b.tokens = min((uint64_t) burst * 1000, b.tokens + (now - b.last) * rate);
+  b.last = now;
+  
+  if (b.tokens >= 1000) {
+    b.tokens -= 1000;
+    if (b.backoff && now - b.lastStorm >= STORM_QUIET)
+      b.backoff = 0;
+    return true;
+  }
+  
+  b.backoff = b.backoff ? min(b.backoff * 2, MAX_BACKOFF) : MIN_BACKOFF;
+  b.mutedUntil = now + b.backoff;
+  b.lastStorm = now;
+  b.dropped++;
+  return false;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cSectionLimiter::Report(uint64_t now)
+{
+  lastReport = now;
+  
+  for (std::map<uint32_t, Bucket>::iterator i = buckets.begin(); i != buckets.end(); i++)
+  {
+    Bucket& b = i->second;
+    if (!b.dropped)
+      continue;
+      
+    if ((i->first & 0xFF000000) == 0xFF000000)
+      dprint(L_ERR, "(F:%d) Section storm on PID 0x%04X: dropped %d sections, backing off %d ms.", filterNum, i->first & 0xFFFF, b.dropped, b.backoff);
+    else
+      dprint(L_ERR, "(F:%d) Section storm on PID 0x%04X, table 0x%02X: dropped %d sections, backing off %d ms.", filterNum, i->first >> 8, i->first & 0xFF, b.dropped, b.backoff);
+    b.dropped = 0;
+  }
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
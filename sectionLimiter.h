@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2006-2010 Alex Lasnier <alex@fepg.org>
+ *
+ * This file is part of ATSC EPG
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __ATSC_SECTION_LIMITER_H
+#define __ATSC_SECTION_LIMITER_H
+
+#include <map>
+#include <stdint.h>
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+// Token buckets per PID and per table on a PID, so a multiplexer flooding
+// one of them cannot keep a section handler thread busy. A bucket that runs
+// dry drops everything for a back-off time that doubles while the storm 
+// lasts. Drops are logged once per interval instead of per section.
+class cSectionLimiter
+{
+public:
+  cSectionLimiter(int FilterNum);
+  
+  bool Allow(uint16_t pid, uint8_t tid);
+  void Clear(void);
+  
+private:
+  struct Bucket {
+    Bucket(void) : tokens(-1), last(0), mutedUntil(0), lastStorm(0), backoff(0), dropped(0) {}
+    
+    int tokens; // Thousandths, -1 until first used
+    uint64_t last;
+    uint64_t mutedUntil;
+    uint64_t lastStorm;
+    int backoff; // ms
+    int dropped; // Since the last report
+  };
+  
+  static bool Take(Bucket& b, int rate, int burst, uint64_t now);
+  void Report(uint64_t now);
+  
+  std::map<uint32_t, Bucket> buckets; // PID << 8 | TID, PID alone as 0xFF << 24 | PID
+  uint64_t lastReport;
+  int filterNum;
+};
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+#endif //__ATSC_SECTION_LIMITER_H
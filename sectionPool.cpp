@@ -0,0 +1,320 @@
+/*
+ * Copyright (C) 2006-2010 Alex Lasnier <alex@fepg.org>
+ *
+ * This file is part of ATSC EPG
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <time.h>
+#include <string.h>
+
+#include "sectionPool.h"
+#include "config.h"
+#include "stats.h"
+#include "tools.h"
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+#define WORKER_WAIT 100 // ms
+
+cSectionPool SectionPool;
+
+
+//----------------------------------------------------------------------------
+
+static uint64_t NowUs(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+class cSectionWorker : public cThread
+{
+public:
+  cSectionWorker(int num) : cThread(*cString::sprintf("ATSC section parser %d", num), true) {}
+  
+  void Stop(void) { Cancel(3); }
+  
+protected:
+  virtual void Action(void);
+};
+
+
+//----------------------------------------------------------------------------
+
+void cSectionWorker::Action(void)
+{
+  while (Running()) 
+  {
+    if (cSectionJob* job = SectionPool.Next()) {
+      job->Parse();
+      SectionPool.Finished(job);
+    }
+  }
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+cSectionJob::cSectionJob(uint16_t Pid, const uint8_t* Data, int Length)
+{
+  data = new uint8_t[Length];
+  memcpy(data, Data, Length);
+  length = Length;
+  pid = Pid;
+  table = NULL;
+  done = false;
+  refs = 2; // The filter and the queue
+  submitted = NowUs();
+}
+
+
+//----------------------------------------------------------------------------
+
+cSectionJob::~cSectionJob()
+{
+  delete table;
+  delete[] data;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cSectionJob::Parse(void)
+{
+  switch (Tid())
+  {
+    case 0xCB: 
+      table = new EIT(data, length); 
+    break;
+    
+    case 0xCC: 
+    {
+      ETT* ett = new ETT(data, length);
+      if (!config.descriptionWindow)
+        ett->NumberOfStrings(); // Decode now, not on the filter's thread
+      table = ett;
+    }
+    break;
+    
+    default:
+      table = new PSIPTable(data, length);
+    break;
+  }
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+cSectionPool::cSectionPool(void)
+{
+  stopping = false;
+  latencySum = latencyCount = latencyMax = 0;
+  queueMax = 0;
+}
+
+
+//----------------------------------------------------------------------------
+
+cSectionPool::~cSectionPool()
+{
+  Stop();
+}
+
+
+//----------------------------------------------------------------------------
+
+void cSectionPool::Start(int Workers)
+{
+  Stop();
+  if (Workers <= 0)
+    return;
+  
+  cMutexLock lock(&mutex);
+  stopping = false;
+  for (int i=0; i<Workers; i++) {
+    cSectionWorker* worker = new cSectionWorker(i+1);
+    workers.push_back(worker);
+    worker->Start();
+  }
+  dprint(L_MSG, "Parsing sections on %d threads.", Workers);
+}
+
+
+//----------------------------------------------------------------------------
+
+void cSectionPool::Stop(void)
+{
+  std::vector<cSectionWorker*> stopped;
+  {
+    cMutexLock lock(&mutex);
+    stopped.swap(workers);
+    stopping = true;
+    ready.Broadcast();
+  }
+  
+  for (size_t i=0; i<stopped.size(); i++) {
+    stopped[i]->Stop();
+    delete stopped[i];
+  }
+  
+  // Filters may still be waiting for sections that were queued
+  while (cSectionJob* job = Next()) {
+    job->Parse();
+    Finished(job);
+  }
+}
+
+
+//----------------------------------------------------------------------------
+
+int cSectionPool::Workers(void)
+{
+  cMutexLock lock(&mutex);
+  return workers.size();
+}
+
+
+//----------------------------------------------------------------------------
+
+int cSectionPool::Backlog(void)
+{
+  cMutexLock lock(&mutex);
+  return queue.size();
+}
+
+
+//----------------------------------------------------------------------------
+
+cSectionJob* cSectionPool::Submit(uint16_t Pid, const uint8_t* Data, int Length)
+{
+  cMutexLock lock(&mutex);
+  if (workers.empty())
+    return NULL;
+  
+  cSectionJob* job = new cSectionJob(Pid, Data, Length);
+  queue.push_back(job);
+  ready.Broadcast();
+  
+  if ((int) queue.size() > queueMax) {
+    queueMax = queue.size();
+    Stats.Set(S_SECTION_QUEUE_MAX, queueMax);
+  }
+  Stats.Set(S_SECTION_QUEUE, queue.size());
+  
+  return job;
+}
+
+
+//----------------------------------------------------------------------------
+
+cSectionJob* cSectionPool::Next(void)
+{
+  cMutexLock lock(&mutex);
+  if (queue.empty() && !stopping)
+    ready.TimedWait(mutex, WORKER_WAIT);
+  if (queue.empty())
+    return NULL;
+  
+  cSectionJob* job = queue.front();
+  queue.pop_front();
+  Stats.Set(S_SECTION_QUEUE, queue.size());
+  return job;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cSectionPool::Finished(cSectionJob* job)
+{
+  {
+    cMutexLock lock(&mutex);
+    job->done = true;
+  }
+  Stats.Add(S_SECTIONS_PARALLEL);
+  Release(job);
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cSectionPool::Done(cSectionJob* job)
+{
+  cMutexLock lock(&mutex);
+  return job->done;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cSectionPool::Committed(cSectionJob* job)
+{
+  uint64_t latency = NowUs() - job->submitted;
+  
+  cMutexLock lock(&mutex);
+  latencySum += latency;
+  latencyCount++;
+  if (latency > latencyMax) {
+    latencyMax = latency;
+    Stats.Set(S_SECTION_LATENCY_MAX, latencyMax);
+  }
+  Stats.Set(S_SECTION_LATENCY, latencySum / latencyCount);
+}
+
+
+//----------------------------------------------------------------------------
+
+void cSectionPool::Release(cSectionJob* job)
+{
+  cMutexLock lock(&mutex);
+  if (--job->refs == 0)
+    delete job;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+cSectionJob* cSectionQueue::Pop(void)
+{
+  if (jobs.empty() || !SectionPool.Done(jobs.front()))
+    return NULL;
+    
+  cSectionJob* job = jobs.front();
+  jobs.pop_front();
+  return job;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cSectionQueue::Clear(void)
+{
+  for (size_t i=0; i<jobs.size(); i++)
+    SectionPool.Release(jobs[i]);
+  jobs.clear();
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
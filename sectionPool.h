@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2006-2010 Alex Lasnier <alex@fepg.org>
+ *
+ * This file is part of ATSC EPG
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __ATSC_SECTION_POOL_H
+#define __ATSC_SECTION_POOL_H
+
+#include <deque>
+#include <vector>
+
+#include <vdr/thread.h>
+
+#include "tables.h"
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+// A copy of a section handed to the worker pool, together with the table
+// parsed from it. Jobs are reference counted: the filter that submitted it
+// and the pool's queue each hold one until they are done with it.
+class cSectionJob
+{
+public:
+  uint16_t Pid(void) const { return pid; }
+  uint8_t Tid(void) const { return data[0]; }
+  const uint8_t* Data(void) const { return data; }
+  const PSIPTable* Table(void) const { return table; }
+
+private:
+  friend class cSectionPool;
+  friend class cSectionWorker;
+  
+  cSectionJob(uint16_t Pid, const uint8_t* Data, int Length);
+ ~cSectionJob();
+  
+  void Parse(void);
+  
+  uint8_t* data;
+  int length;
+  uint16_t pid;
+  PSIPTable* table;
+  bool done;
+  int refs;
+  uint64_t submitted; // us
+};
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+class cSectionWorker;
+
+// Parses EIT and ETT sections (CRC, Huffman and string decoding) on a 
+// number of threads, so that the section handlers of several devices do 
+// not queue up behind one core.
+class cSectionPool
+{
+public:
+  cSectionPool(void);
+ ~cSectionPool();
+ 
+  void Start(int Workers);
+  void Stop(void);
+  int Workers(void);
+  int Backlog(void); // Sections waiting for a worker
+  
+  // Returns NULL if there are no workers; the section is then parsed inline
+  cSectionJob* Submit(uint16_t Pid, const uint8_t* Data, int Length);
+  bool Done(cSectionJob* job);
+  void Committed(cSectionJob* job);
+  void Release(cSectionJob* job);
+  
+private:
+  friend class cSectionWorker;
+  
+  cSectionJob* Next(void);
+  void Finished(cSectionJob* job);
+  
+  std::vector<cSectionWorker*> workers;
+  std::deque<cSectionJob*> queue;
+  bool stopping;
+  
+  uint64_t latencySum; // us, from submission to commit
+  uint64_t latencyCount;
+  uint64_t latencyMax;
+  int queueMax;
+  
+  cMutex mutex;
+  cCondVar ready;
+};
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+// The jobs a filter has submitted, in the order they are to be committed.
+class cSectionQueue
+{
+public:
+ ~cSectionQueue() { Clear(); }
+ 
+  void Push(cSectionJob* job) { jobs.push_back(job); }
+  cSectionJob* Pop(void); // Next job, if it has been parsed
+  void Clear(void);
+  bool Empty(void) const { return jobs.empty(); }
+  
+private:
+  std::deque<cSectionJob*> jobs;
+};
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+extern cSectionPool SectionPool;
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+#endif //__ATSC_SECTION_POOL_H
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2006-2010 Alex Lasnier <alex@fepg.org>
+ *
+ * This file is part of ATSC EPG
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __ATSC_SERVICES_H
+#define __ATSC_SERVICES_H
+
+#include <vdr/channels.h>
+#include <vdr/epg.h>
+
+
+// Services provided to other plugins through cPluginManager::CallFirstService().
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+// Returns the description of an ATSC event, decoding it if it is still 
+// stored compressed.
+
+#define ATSCEPG_DESCRIPTION_SERVICE "AtscEpg-Description-v1.0"
+
+struct AtscEpg_Description_v1_0 {
+  tChannelID channelID; // in
+  tEventID eventID;     // in
+  cString description;  // out, NULL if not available
+};
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+// Searches the titles and descriptions of the ATSC guide. All words of the
+// query must match; "word*" matches words starting with "word" and words in
+// double quotes must appear in that order. Results are sorted by start time.
+// The caller provides room for maxResults results.
+
+#define ATSCEPG_SEARCH_SERVICE "AtscEpg-Search-v1.0"
+
+struct AtscEpg_SearchResult_v1_0 {
+  tChannelID channelID;
+  tEventID eventID;
+  time_t startTime;
+  int duration;
+};
+
+struct AtscEpg_Search_v1_0 {
+  const char* query;                  // in
+  int maxResults;                     // in
+  AtscEpg_SearchResult_v1_0* results; // in, array of maxResults elements
+  int numResults;                     // out, -1 if the query is invalid
+};
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+// Returns the ATSC events overlapping [from, to), ordered by virtual channel
+// number and then start time. Served from a snapshot of the guide; it does 
+// not lock the schedules. The caller provides room for maxEntries entries, 
+// numEntries is the size of the whole slice and may be larger.
+
+#define ATSCEPG_GRID_SERVICE "AtscEpg-Grid-v1.0"
+
+struct AtscEpg_GridEntry_v1_0 {
+  tChannelID channelID;
+  tEventID eventID;
+  time_t startTime;
+  int duration;
+  cString title;
+};
+
+struct AtscEpg_Grid_v1_0 {
+  time_t from;                      // in
+  time_t to;                        // in
+  int maxEntries;                   // in
+  AtscEpg_GridEntry_v1_0* entries;  // in, array of maxEntries elements
+  int numEntries;                   // out
+};
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+#endif //__ATSC_SERVICES_H
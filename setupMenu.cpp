@@ -24,6 +24,8 @@
 #include "log.h"
 #include "setupMenu.h"
 #include "scanner.h"
+#include "vdrInterface.h"
+#include "sectionPool.h"
 
 
 //////////////////////////////////////////////////////////////////////////////
@@ -57,6 +59,14 @@ LogParameters logParameters[] = {
 cATSCSetupMenu::cATSCSetupMenu(void)
 {
   //newSetTime = config.setTime;
+  newUseEpgHandlers = config.useEpgHandlers;
+  newEpgHorizon = config.epgHorizon;
+  newEpgBudget = config.epgBudget;
+  newDescriptionWindow = config.descriptionWindow;
+  newUpdateChannels = config.updateChannels;
+  newSectionWorkers = config.sectionWorkers;
+  newHarvest = config.harvest;
+  newThrottle = config.throttle;
   newLogConsole = config.logConsole;
   newLogFile    = config.logFile;
   newLogSyslog  = config.logSyslog;
@@ -65,6 +75,19 @@ cATSCSetupMenu::cATSCSetupMenu(void)
   //Add(new cMenuEditBoolItem("Set system time", &newSetTime, "No", "Yes"));
   
   Add(scan = new cOsdItem("Channel Scan..."));
+  Add(new cMenuEditBoolItem("Update channels from VCT", &newUpdateChannels));
+  AddEmptyLine();
+  
+  AddCategory("EPG");
+  Add(new cMenuEditIntItem("Guide horizon (days)", &newEpgHorizon, 1, 16));
+  Add(new cMenuEditIntItem("Memory budget (MB)", &newEpgBudget, 0, 4096, "unlimited"));
+  Add(new cMenuEditIntItem("Decode descriptions (h)", &newDescriptionWindow, 0, 384, "always"));
+  Add(new cMenuEditIntItem("Parser threads", &newSectionWorkers, 0, 16, "none"));
+  Add(new cMenuEditBoolItem("Harvest on idle tuners", &newHarvest));
+  Add(new cMenuEditBoolItem("Throttle while recording", &newThrottle));
+#ifdef USE_EPG_HANDLERS
+  Add(new cMenuEditBoolItem("Use EPG handlers", &newUseEpgHandlers));
+#endif
   AddEmptyLine();
 /*
   AddCategory("Devices");
@@ -97,6 +120,17 @@ cATSCSetupMenu::cATSCSetupMenu(void)
 void cATSCSetupMenu::Store(void)
 {
   //SetupStore("setTime",  config.setTime   = newSetTime);
+  SetupStore("useEpgHandlers", config.useEpgHandlers = newUseEpgHandlers);
+  SetupStore("epgHorizon",     config.epgHorizon     = newEpgHorizon);
+  SetupStore("epgBudget",      config.epgBudget      = newEpgBudget);
+  SetupStore("descriptionWindow", config.descriptionWindow = newDescriptionWindow);
+  SetupStore("updateChannels", config.updateChannels = newUpdateChannels);
+  SetupStore("harvest",        config.harvest        = newHarvest);
+  SetupStore("throttle",       config.throttle       = newThrottle);
+  if (newSectionWorkers != config.sectionWorkers) {
+    SetupStore("sectionWorkers", config.sectionWorkers = newSectionWorkers);
+    SectionPool.Start(config.sectionWorkers);
+  }
 #ifdef AE_ENABLE_LOG   
   int newLogType = 0;
   const LogParameters* lp = logParameters;
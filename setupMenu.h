@@ -38,6 +38,14 @@ protected:
 private:
   cOsdItem* scan;
   //int  newSetTime;
+  int newUseEpgHandlers;
+  int newEpgHorizon;
+  int newEpgBudget;
+  int newDescriptionWindow;
+  int newUpdateChannels;
+  int newSectionWorkers;
+  int newHarvest;
+  int newThrottle;
   int newLogConsole;
   int newLogFile;
   int newLogSyslog;
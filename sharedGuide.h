@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2006-2010 Alex Lasnier <alex@fepg.org>
+ *
+ * This file is part of ATSC EPG
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __ATSC_SHARED_GUIDE_H
+#define __ATSC_SHARED_GUIDE_H
+
+#include <stdint.h>
+
+
+// Layout of the guide snapshot file published with --shared-guide. This 
+// header does not depend on VDR so external programs can include it.
+//
+// The file holds a header and two buffers. The plugin fills the inactive
+// buffer and then switches 'active' while 'sequence' is odd. To read:
+//
+//   1. Map the whole file read-only. If 'flags' has SHARED_GUIDE_STALE set,
+//      the file was replaced, open and map it again.
+//   2. Read 'sequence', retry while it is odd. Memory barrier.
+//   3. Use the SharedGuideSnapshot at bufferOffset[active].
+//   4. Memory barrier. If 'sequence' changed, the data may have been
+//      overwritten; discard what was read and start over.
+//
+// All offsets in a snapshot are relative to its start. Integers are in the
+// byte order of the host.
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+#define SHARED_GUIDE_MAGIC    "ATSCSHG"
+#define SHARED_GUIDE_VERSION  1
+#define SHARED_GUIDE_STALE    0x00000001
+
+
+struct SharedGuideHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t flags;
+  volatile uint32_t sequence;
+  volatile uint32_t active;    // 0 or 1
+  volatile uint64_t generation; // Snapshots published so far
+  uint64_t bufferOffset[2];
+  uint64_t bufferSize;
+};
+
+
+struct SharedGuideSnapshot {
+  int64_t published;       // time_t
+  int64_t start;           // Period covered
+  int64_t end;
+  uint32_t numChannels;
+  uint32_t numEvents;
+  uint32_t channelsOffset; // SharedGuideChannel[numChannels]
+  uint32_t eventsOffset;   // SharedGuideEvent[numEvents]
+  uint32_t stringsOffset;  // UTF-8, NUL terminated
+  uint32_t stringsSize;
+};
+
+
+// Sorted by virtual channel number
+struct SharedGuideChannel {
+  uint16_t tsid;
+  uint16_t programNumber;  // VDR channel ID is A-0-<tsid>-<programNumber>
+  uint16_t majorNumber;
+  uint16_t minorNumber;
+  uint32_t firstEvent;
+  uint32_t numEvents;
+};
+
+
+// Sorted by channel, then start time
+struct SharedGuideEvent {
+  int64_t startTime;       // time_t
+  int32_t duration;        // Seconds
+  uint16_t eventId;
+  uint16_t channel;        // Index of the channel
+  uint32_t title;          // Offsets into the strings, 0 is ""
+  uint32_t description;
+};
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+#endif //__ATSC_SHARED_GUIDE_H
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2006-2010 Alex Lasnier <alex@fepg.org>
+ *
+ * This file is part of ATSC EPG
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string>
+
+#include "stats.h"
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+cAtscStats Stats;
+
+// Must match the order of StatType
+static const char* const statNames[S_NUM_STATS] = {
+  "Events added",
+  "Events updated",
+  "Events beyond horizon",
+  "Descriptions added",
+  "Descriptions deferred",
+  "Descriptions decoded",
+  "Descriptions stored",
+  "Descriptions raw bytes",
+  "Tables beyond horizon",
+  "EPG events",
+  "EPG bytes",
+  "EPG budget (bytes)",
+  "Events pruned",
+  "Bytes pruned",
+  "Guide events",
+  "Guide strings",
+  "Guide bytes",
+  "Search index words",
+  "Sections parsed by pool",
+  "Section queue",
+  "Section queue (max)",
+  "Section latency (us)",
+  "Section latency max (us)",
+  "Acquisitions throttled",
+  "Sections with bad length",
+  "Sections with CRC errors",
+  "Sections dropped (rate limit)"
+};
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+cAtscStats::cAtscStats(void)
+{
+  for (int i=0; i<S_NUM_STATS; i++)
+    values[i] = 0;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cAtscStats::Add(StatType type, long long value)
+{
+  cMutexLock lock(&mutex);
+  values[type] += value;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cAtscStats::Set(StatType type, long long value)
+{
+  cMutexLock lock(&mutex);
+  values[type] = value;
+}
+
+
+//----------------------------------------------------------------------------
+
+long long cAtscStats::Get(StatType type)
+{
+  cMutexLock lock(&mutex);
+  return values[type];
+}
+
+
+//----------------------------------------------------------------------------
+
+cString cAtscStats::ToText(void)
+{
+  cMutexLock lock(&mutex);
+  
+  std::string text;
+  for (int i=0; i<S_NUM_STATS; i++)
+  {
+    text += *cString::sprintf("%-24s %lld", statNames[i], values[i]);
+    if (i < S_NUM_STATS-1)
+      text += "\n";
+  }
+  
+  return text.c_str();
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
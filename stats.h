@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2006-2010 Alex Lasnier <alex@fepg.org>
+ *
+ * This file is part of ATSC EPG
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __ATSC_STATS_H
+#define __ATSC_STATS_H
+
+#include <vdr/thread.h>
+#include <vdr/tools.h>
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+enum StatType {
+  S_EVENTS_ADDED,
+  S_EVENTS_UPDATED,
+  S_EVENTS_HORIZON,
+  S_DESCRIPTIONS_ADDED,
+  S_DESCRIPTIONS_DEFERRED,
+  S_DESCRIPTIONS_DECODED,
+  S_DESCRIPTIONS_STORED,
+  S_DESCRIPTIONS_RAW_BYTES,
+  S_TABLES_HORIZON,
+  S_EPG_EVENTS,
+  S_EPG_BYTES,
+  S_EPG_BUDGET,
+  S_EVENTS_PRUNED,
+  S_BYTES_PRUNED,
+  S_GUIDE_EVENTS,
+  S_GUIDE_STRINGS,
+  S_GUIDE_BYTES,
+  S_SEARCH_WORDS,
+  S_SECTIONS_PARALLEL,
+  S_SECTION_QUEUE,
+  S_SECTION_QUEUE_MAX,
+  S_SECTION_LATENCY,
+  S_SECTION_LATENCY_MAX,
+  S_THROTTLED,
+  S_SECTIONS_BAD_LENGTH,
+  S_SECTIONS_CRC,
+  S_SECTIONS_DROPPED,
+  
+  S_NUM_STATS
+};
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+class cAtscStats
+{
+public:
+  cAtscStats(void);
+ 
+  void Add(StatType type, long long value = 1);
+  void Set(StatType type, long long value);
+  long long Get(StatType type);
+  cString ToText(void);
+  
+private:
+  long long values[S_NUM_STATS];
+  cMutex mutex;
+};
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+extern cAtscStats Stats;
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+#endif //__ATSC_STATS_H
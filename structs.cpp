@@ -32,6 +32,7 @@ Table::Table(void)
   pid = 0; 
   tid = 0; 
   table_type = 0;
+  version = 0;
   number_bytes = 0;
 }
 
@@ -69,7 +70,8 @@ Event::Event(const Event& arg)
   version_number    = arg.version_number;
   table_id          = arg.table_id;
   ETM_location      = arg.ETM_location;
-  title_text        = strdup(arg.title_text);
+  attributes        = arg.attributes;
+  title_text        = arg.title_text ? strdup(arg.title_text) : NULL;
 }
 
 
@@ -83,8 +85,9 @@ const Event& Event::operator= (const Event& arg)
   version_number    = arg.version_number;
   table_id          = arg.table_id;
   ETM_location      = arg.ETM_location;
+  attributes        = arg.attributes;
   free(title_text);
-  title_text        = strdup(arg.title_text);
+  title_text        = arg.title_text ? strdup(arg.title_text) : NULL;
   return *this;
 }
 
@@ -107,43 +110,89 @@ AtscChannel::AtscChannel(void)
   minorChannelNumber = 0;
   sid = 0;
   hasEit = true;
+  hasPids = false;
 }
 
 
 //----------------------------------------------------------------------------
 
-void AtscChannel::SetPids(int Vpid, int Ppid, int Vtype, int *Dpids, char DLangs[][MAXLANGCODE2])
+static void SetChannelPids(cChannel* channel, int Vpid, int Ppid, int Vtype, int *Dpids, char DLangs[][MAXLANGCODE2])
 {
   int Apids[1] = { 0 };
   int Spids[1] = { 0 };
   char ALangs[1][MAXLANGCODE2] = { "" };
   char SLangs[1][MAXLANGCODE2] = { "" };
 #if VDRVERSNUM < 10715  
-  channel.SetPids(Vpid, Ppid, Vtype, Apids, ALangs, Dpids, DLangs, Spids, SLangs, 0);
+  channel->SetPids(Vpid, Ppid, Vtype, Apids, ALangs, Dpids, DLangs, Spids, SLangs, 0);
 #else
   int Atypes[1] = { 0 };
   int Dtypes[MAXDPIDS + 1] = { 0 };
   for (int i=0; i<MAXDPIDS && Dpids[i]; i++)
     Dtypes[i] = 0x6A; // SI::AC3DescriptorTag
 
-  channel.SetPids(Vpid, Ppid, Vtype, Apids, Atypes, ALangs, Dpids, Dtypes, DLangs, Spids, SLangs, 0);
+  channel->SetPids(Vpid, Ppid, Vtype, Apids, Atypes, ALangs, Dpids, Dtypes, DLangs, Spids, SLangs, 0);
 #endif
 }
 
 
+//----------------------------------------------------------------------------
+
+void AtscChannel::SetPids(int Vpid, int Ppid, int Vtype, int *Dpids, char DLangs[][MAXLANGCODE2])
+{
+  SetChannelPids(&channel, Vpid, Ppid, Vtype, Dpids, DLangs);
+}
+
+
+//----------------------------------------------------------------------------
+
+bool AtscChannel::SamePids(const cChannel* other) const
+{
+  if (channel.Vpid() != other->Vpid() || channel.Ppid() != other->Ppid() || channel.Vtype() != other->Vtype())
+    return false;
+    
+  for (int i=0; i<MAXDPIDS; i++) {
+    if (channel.Dpid(i) != other->Dpid(i))
+      return false;
+    if (!channel.Dpid(i))
+      break;
+    if (strcmp(channel.Dlang(i), other->Dlang(i)) != 0)
+      return false;
+  }
+  
+  return true;
+}
+
+
+//----------------------------------------------------------------------------
+
+void AtscChannel::CopyPidsTo(cChannel* other) const
+{
+  int Dpids[MAXDPIDS + 1] = { 0 };
+  char DLangs[MAXDPIDS][MAXLANGCODE2] = { "" };
+  for (int i=0; i<MAXDPIDS && channel.Dpid(i); i++) {
+    Dpids[i] = channel.Dpid(i);
+    strn0cpy(DLangs[i], channel.Dlang(i), MAXLANGCODE2);
+  }
+  
+  SetChannelPids(other, channel.Vpid(), channel.Ppid(), channel.Vtype(), Dpids, DLangs);
+}
+
+
 //////////////////////////////////////////////////////////////////////////////
 
 
-SidTranslator::SidTranslator(void)
+ChannelDirectory::ChannelDirectory(void)
 {
-  map = NULL;
-  size = 0;
+  table = NULL;
+  mask = 0;
+  tsid = -1;
+  version = -1;
 }
 
 
 //----------------------------------------------------------------------------
 
-SidTranslator::~SidTranslator()
+ChannelDirectory::~ChannelDirectory()
 {
   Clear();
 }
@@ -151,50 +200,113 @@ SidTranslator::~SidTranslator()
 
 //----------------------------------------------------------------------------
 
-
-void SidTranslator::Update(VCT* vct)
+void ChannelDirectory::Update(const ChannelMap& map)
 {
+  if (table && map.tsid == tsid && map.version == version)
+    return; // Same table, nothing to rebuild
+    
   Clear();
-
-  size = vct->NumberOfChannels();
-  map = new SidPair[size];
   
-  for (int i=0; i<size; i++)
+  tsid = map.tsid;
+  version = map.version;
+
+  int size = 16;
+  while (size < 2 * (int) map.channels.size())
+    size <<= 1;
+    
+  mask = size - 1;
+  table = new Entry[size];
+  memset(table, 0, size * sizeof(Entry));
+  
+  for (unsigned int i=0; i<map.channels.size(); i++)
   {
-    const AtscChannel* ch = vct->GetChannel(i);
-    map[i].vctSid = ch->Sid();
-    map[i].pmtSid = ch->ProgramNumber();
+    uint16_t sourceId = map.channels[i].sourceId;
+    if (sourceId == 0 || Find(sourceId) >= 0)
+      continue;
+      
+    int slot = sourceId & mask;
+    while (table[slot].sourceId)
+      slot = (slot + 1) & mask;
+      
+    table[slot].sourceId = sourceId;
+    table[slot].pmtSid = map.channels[i].programNumber;
   }
+  
+  dprint(L_DBG, "Channel directory: %d channels for TSID %d (version %d)", (int) map.channels.size(), tsid, version);
 }
 
 
 //----------------------------------------------------------------------------
 
+cChannel* ChannelDirectory::GetChannel(uint16_t sourceId)
+{
+  int slot = Find(sourceId);
+  if (slot < 0)
+    return NULL;
+    
+  return Channels.GetByChannelID(tChannelID(cSource::stAtsc, 0x00, tsid, table[slot].pmtSid), true);
+}
+
+
+//----------------------------------------------------------------------------
 
-uint16_t SidTranslator::GetPmtSid(uint16_t sid) const
+uint16_t ChannelDirectory::GetPmtSid(uint16_t sourceId) const
 {
-  if (!map)
-    return 0;
-  
-  for (int i=0; i<size; i++)
-    if (map[i].vctSid == sid)
-      return map[i].pmtSid;
-      
-  return 0;
+  int slot = Find(sourceId);
+  return (slot >= 0) ? table[slot].pmtSid : 0;
 }
 
 
 //----------------------------------------------------------------------------
 
+void ChannelDirectory::Clear(void)
+{
+  delete[] table;
+  table = NULL;
+  mask = 0;
+  tsid = -1;
+  version = -1;
+}
+
+
+//----------------------------------------------------------------------------
 
-void SidTranslator::Clear(void)
+int ChannelDirectory::Find(uint16_t sourceId) const
 {
-  size = 0;
-  delete[] map;
-  map = NULL;
+  if (!table || !sourceId)
+    return -1;
+    
+  for (int slot = sourceId & mask; table[slot].sourceId; slot = (slot + 1) & mask)
+    if (table[slot].sourceId == sourceId)
+      return slot;
+  
+  return -1;
 }
 
 
 //////////////////////////////////////////////////////////////////////////////
 
 
+u16 RatingRegion::AddString(const std::string& s)
+{
+  if (s.empty() || strings.size() + s.size() + 1 > 0xFFFF)
+    return 0;
+    
+  u16 offset = strings.size();
+  strings.append(s.c_str(), s.size() + 1);
+  return offset;
+}
+
+
+//----------------------------------------------------------------------------
+
+const char* RatingRegion::Abbrev(u8 dimension, u8 value) const
+{
+  if (dimension >= dimensions.size() || value >= dimensions[dimension].numValues)
+    return "";
+    
+  return String(dimensions[dimension].abbrev[value]);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
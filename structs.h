@@ -21,6 +21,8 @@
 #define __ATSC_STRUCTS_H
 
 #include <string>
+#include <vector>
+#include <string.h>
 
 #include <vdr/channels.h>
 
@@ -37,6 +39,7 @@ struct Table
   u16 pid;
   u8  tid;
   u16 table_type;
+  u8  version;
   u32 number_bytes;
 };
 
@@ -44,6 +47,32 @@ struct Table
 //////////////////////////////////////////////////////////////////////////////
 
 
+// Compact summary of the descriptors of an EIT event
+struct EventAttributes
+{
+  EventAttributes(void) { memset(this, 0, sizeof(*this)); }
+
+  u8  genre[4];          // ATSC genre codes (A/65 Table 6.20), 0 = none
+  u32 ratings;           // Rating values, 4 bits per dimension (dimensions 0-7)
+  u8  ratingRegion;      // 0 = not rated
+  
+  u8  numGenres    : 3;
+  u8  captions     : 1;  // Caption service descriptor present
+  u8  digitalCC    : 1;
+  u8  easyReader   : 1;
+  u8  wideAspect   : 1;
+  u8  ac3          : 1;  // AC-3 audio descriptor present
+  
+  u8  audioChannels: 4;  // AC-3 num_channels code
+  u8  surround     : 1;  // Dolby surround encoded
+  
+  u8 Rating(u8 dimension) const { return (dimension < 8) ? (ratings >> (4*dimension)) & 0x0F : 0; }
+};
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
 struct Event
 {
   Event(void);
@@ -61,6 +90,7 @@ struct Event
   u8 version_number;
   u8 table_id;
   u8 ETM_location;
+  EventAttributes attributes;
   
 private:
   char* title_text;  
@@ -80,6 +110,7 @@ public:
   int Sid(void) const { return sid; }
   int ProgramNumber(void) const { return channel.Sid(); }
   bool HasEit(void) const { return hasEit; }
+  bool HasPids(void) const { return hasPids; } // Has a service location descriptor
   const char* LongName(void) const  { return channel.Name(); }
   const char* ShortName(void) const { return channel.ShortName(); }
   cChannel* VDRChannel(void) { return &channel; }
@@ -91,8 +122,11 @@ public:
   void SetShortName(const char* n) { channel.SetName(n, n, ""); }
   void SetLongName(const char* n) { channel.SetName(n, channel.ShortName(), ""); }
   void SetPids(int Vpid, int Ppid, int Vtype, int *Dpids, char DLangs[][MAXLANGCODE2]);
+  bool SamePids(const cChannel* other) const;
+  void CopyPidsTo(cChannel* other) const;
   void SetNumber(int Number) { channel.SetNumber(Number); }
   void SetHasEit(bool he) { hasEit = he; }
+  void SetHasPids(bool hp) { hasPids = hp; }
   
 private:
   cChannel channel;
@@ -101,32 +135,94 @@ private:
   u16 minorChannelNumber;
   u16 sid; // Not the same as VDR's channel sid
   bool hasEit;
+  bool hasPids;
+};
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+// The parts of a VCT needed to acquire the EPG of a transport stream
+struct ChannelMap
+{
+  ChannelMap(void) { tsid = 0; version = 0; }
+  
+  struct Entry {
+    u16 sourceId;
+    u16 programNumber;
+    u16 majorNumber;
+    u16 minorNumber;
+    bool hasEit;
+  };
+  
+  u16 tsid;
+  u8  version;
+  std::vector<Entry> channels;
+};
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+// A rating region as defined by an RRT. The strings are decoded once and 
+// kept in one buffer; dimensions and values are addressed by index, as in 
+// content advisory descriptors.
+struct RatingRegion
+{
+  RatingRegion(void) { region = 0; version = 0; name = 0; strings.assign(1, '\0'); }
+  
+  struct Dimension {
+    u16  name;            // Offsets into strings
+    u16  abbrev[16];
+    u16  text[16];
+    u8   numValues;
+    bool graduatedScale;
+  };
+  
+  u8  region;
+  u8  version;
+  u16 name;
+  std::vector<Dimension> dimensions;
+  std::string strings;
+  
+  u16 AddString(const std::string& s);
+  const char* String(u16 offset) const { return strings.c_str() + offset; }
+  const char* Abbrev(u8 dimension, u8 value) const;
 };
 
 
 //////////////////////////////////////////////////////////////////////////////
 
-class VCT;
 
-class SidTranslator
+// Maps VCT source ids to VDR channels for one transport stream. The table
+// is only rebuilt when a new VCT version is received. It holds channel ids
+// rather than pointers, which would dangle once a channel is deleted or 
+// moved in VDR's channel list.
+class ChannelDirectory
 {
 public:
-  SidTranslator(void);
- ~SidTranslator();
+  ChannelDirectory(void);
+ ~ChannelDirectory();
  
-  void Update(VCT* vct);
-  uint16_t GetPmtSid(uint16_t vctSid) const;
-  
-private:
+  void Update(const ChannelMap& map);
+  cChannel* GetChannel(uint16_t sourceId); // With the Channels lock held
+  uint16_t GetPmtSid(uint16_t sourceId) const;
+  int TSID(void) const { return tsid; }
+  int Version(void) const { return version; }
   void Clear(void);
+
+private:
+  int Find(uint16_t sourceId) const;
   
-  struct SidPair {
-    uint16_t vctSid; 
+  struct Entry {
+    uint16_t sourceId; // 0 is reserved by A/65, marks an empty slot
     uint16_t pmtSid;
   };
   
-  SidPair* map;
-  int size;
+  Entry* table;
+  int mask;
+  int tsid;
+  int version;
 };
 
 
@@ -25,6 +25,7 @@
 
 #include "tables.h"
 #include "types.h"
+#include "stats.h"
 
 
 //////////////////////////////////////////////////////////////////////////////
@@ -59,8 +60,9 @@ void PSIPTable::Update(const u8* data, int length)
   table_id       = data[0];
   section_length = ((data[1] & 0x0F) << 8) | data[2];
   
+  // Counted rather than logged, a broken multiplexer can send thousands
   if (section_length+3 != length) {
-    dprint(L_ERR, "PSIPTable: Insufficient data length.");
+    Stats.Add(S_SECTIONS_BAD_LENGTH);
     crc_passed = false;
     return;
   }
@@ -73,9 +75,17 @@ void PSIPTable::Update(const u8* data, int length)
   protocol_version       = data[8];
 
   crc_passed = SI::CRC32::isValid((const char*)data, section_length+3);
-  if (!crc_passed) {
-    dprint(L_ERR, "ERROR: PSIPTable CRC 32 integrity check failed");    
-  }
+  if (!crc_passed)
+    Stats.Add(S_SECTIONS_CRC);
+}
+
+
+//----------------------------------------------------------------------------
+
+bool PSIPTable::IsValid(const u8* data, int length)
+{
+  return length >= 3 && (((data[1] & 0x0F) << 8) | data[2]) + 3 == length && 
+         SI::CRC32::isValid((const char*) data, length);
 }
 
 
@@ -120,7 +130,7 @@ void MGT::Parse(const u8* data, int length)
     tables[i].pid = ((d[2] & 0x1F) << 8) | d[3];
     tables[i].tid = TableTypeToTID(tableType);  
     
-    //u8  table_type_version_number = d[4] & 0x1F;         
+    tables[i].version = d[4] & 0x1F;         
     tables[i].number_bytes = get_u32(d+5);
     
     u16 table_type_descriptors_length = ((d[9] & 0x0F) << 8) | d[10];
@@ -198,9 +208,17 @@ EIT::EIT(const u8* data, int length) : PSIPTable(data, length)
   numberOfEvents  = data[9];
   events = new Event[numberOfEvents];
   
+  const u8* end = data + section_length + 3 - 4; // CRC
+  
   const uchar* d = data + 10;
   for (u8 i = 0; i < numberOfEvents; i++)
   {
+    // A malformed section ends with the last event that fits
+    if (d + 12 > end || d + 12 + d[9] > end) {
+      numberOfEvents = i;
+      break;
+    }
+    
     events[i].version_number    = version_number;
     events[i].table_id          = table_id;
     events[i].event_id          = ((d[0] & 0x3F) << 8) | d[1];
@@ -211,28 +229,16 @@ EIT::EIT(const u8* data, int length) : PSIPTable(data, length)
     u8 title_length = d[9];
     
     if (title_length > 0) {
-      MultipleStringStructure title_text(d + 10);
-      events[i].SetTitleText( title_text.GetString(0).c_str() ); // Assume single string title
+      events[i].SetTitleText( MultipleStringStructure::FirstString(d + 10, title_length).c_str() ); // Assume single string title
     }
     else
       events[i].SetTitleText("No Title");
 
     u16 descriptors_length = ((d[10 + title_length] & 0x0F) << 8) | d[11 + title_length];
-  
-    /*
-    DescriptorLoop dl(d+12+title_length, descriptors_length);
-    for (Descriptor* dsc = dl.First(); dsc; dsc = dl.Next(dsc))
-    {
-      if (dsc->GetTag() > 0x87) fprintf(stderr, "TAG: 0x%02X\n", dsc->GetTag());
-      switch (dsc->GetTag())
-      {
-        case ContentAdvisoryDescriptorTag: {
-          ContentAdvisoryDescriptor* cad = dynamic_cast<ContentAdvisoryDescriptor*>(dsc);
-        }
-        break;
-      }
-    }
-    */
+    if (d + 12 + title_length + descriptors_length > end)
+      descriptors_length = end - (d + 12 + title_length);
+    ParseEventDescriptors(d + 12 + title_length, descriptors_length, events[i].attributes);
+    
     d += 12 + title_length + descriptors_length;
   } 
   
@@ -312,6 +318,7 @@ VCT::VCT(const u8* data, int length) : PSIPTable(data, length)
       if (dsc->GetTag() == ServiceLocationDescriptorTag)
       {
         ServiceLocationDescriptor* sld = dynamic_cast<ServiceLocationDescriptor*>(dsc);
+        channels[i]->SetHasPids(true);
 
         for (u8 k = 0; k < sld->NumberOfStreams(); k++)
         { 
@@ -391,53 +398,94 @@ VCT::~VCT()
 //////////////////////////////////////////////////////////////////////////////
 
 
+VCTChannelMap::VCTChannelMap(const u8* data, int length) : PSIPTable(data, length)
+{
+  if (!crc_passed)
+    return;
+    
+  map.tsid = table_id_extension;
+  map.version = version_number;
+  
+  u8 numChannels = data[9];
+  map.channels.reserve(numChannels);
+  
+  const u8* d = data + 10;
+  const u8* end = data + section_length + 3 - 4; // CRC
+  
+  for (u8 i = 0; i < numChannels && d + 32 <= end; i++)
+  {
+    ChannelMap::Entry e;
+    e.majorNumber   = (((d[14] & 0x0F) << 8) | (d[15] & 0xFC)) >> 2;
+    e.minorNumber   =  ((d[15] & 0x03) << 8) |  d[16];
+    e.programNumber = get_u16(d+24);
+    e.hasEit        = (d[27] & 0x3F) != 0x04; // Data channel: no EIT
+    e.sourceId      = get_u16(d+28);
+    map.channels.push_back(e);
+    
+    u16 descriptors_length = ((d[30] & 0x03) << 8) | d[31];
+    d += 32 + descriptors_length;
+  }
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
 RRT::RRT(const u8* data, int length) : PSIPTable(data, length)
 {
   if (!crc_passed) {
     return;
   }
   
-  u8 rating_region_name_length =  data[9]; 
+  region.region = table_id_extension & 0xFF;
+  region.version = version_number;
+  
+  const u8* end = data + section_length + 3 - 4; // CRC
   
-  MultipleStringStructure rating_region_name_text( data + 10 );
-  rating_region_name_text.Print(); 
+  u8 rating_region_name_length = data[9]; 
+  if (data + 11 + rating_region_name_length > end)
+    return;
+  if (rating_region_name_length)
+    region.name = region.AddString(MultipleStringStructure::FirstString(data + 10, rating_region_name_length));
 
   u8 dimensions_defined = data[10 + rating_region_name_length];
   
-  const uchar* d = data + 11 + rating_region_name_length;
-  for (u8 i=0; i<dimensions_defined; i++) 
+  const u8* d = data + 11 + rating_region_name_length;
+  for (u8 i=0; i<dimensions_defined && d < end; i++) 
   {
     u8 dimension_name_length = d[0];
-
-    MultipleStringStructure dimension_name_text( d + 1 );
-    dimension_name_text.Print();
-
-    //u1  graduated_scale = (d[1+dimension_name_length] & 0x10) >> 4;
-    u8  values_defined  = (d[1+dimension_name_length] & 0x0F);
+    if (d + 2 + dimension_name_length > end)
+      break;
+      
+    RatingRegion::Dimension dim;
+    memset(&dim, 0, sizeof(dim));
+    if (dimension_name_length)
+      dim.name = region.AddString(MultipleStringStructure::FirstString(d + 1, dimension_name_length));
+    dim.graduatedScale = (d[1+dimension_name_length] & 0x10) >> 4;
+    u8 values_defined  = (d[1+dimension_name_length] & 0x0F);
     
     d += 2 + dimension_name_length;
     
-    for (u8 j=0; j< values_defined; j ++) 
+    for (u8 j=0; j<values_defined && d < end; j++) 
     {
       u8 abbrev_rating_value_length = d[0];
-
-      MultipleStringStructure abbrev_rating_value_text( d + 1 );
-      abbrev_rating_value_text.Print();
-                 
+      if (d + 2 + abbrev_rating_value_length > end)
+        break;
       u8 rating_value_length = d[1+abbrev_rating_value_length];
-      MultipleStringStructure rating_value_text( d + 2 + abbrev_rating_value_length );          
-      abbrev_rating_value_text.Print();
+      if (d + 2 + abbrev_rating_value_length + rating_value_length > end)
+        break;
+        
+      if (abbrev_rating_value_length)
+        dim.abbrev[j] = region.AddString(MultipleStringStructure::FirstString(d + 1, abbrev_rating_value_length));
+      if (rating_value_length)
+        dim.text[j] = region.AddString(MultipleStringStructure::FirstString(d + 2 + abbrev_rating_value_length, rating_value_length));
+      dim.numValues = j + 1;
       
       d += 2 + abbrev_rating_value_length + rating_value_length;
     }
+    
+    region.dimensions.push_back(dim);
   }
-
-  //u16 descriptors_length = ((d[0] & 0x03) << 8) | d[1]; 
- /* 
-  for (i=0; i<N; i++) {
-    descriptor()
-  }
-  */
 }
 
 
@@ -446,19 +494,38 @@ RRT::RRT(const u8* data, int length) : PSIPTable(data, length)
 
 ETT::ETT(const u8* data, int length) : PSIPTable(data, length)
 {
+  mss = NULL;
+  
   if (!crc_passed) {
     source_id = event_id = 0;
-    mss = NULL;
+    raw = NULL;
+    rawLength = 0;
     return;
   }
   
   source_id = get_u16( data + 9 );
   event_id  = (data[11] << 6) | ((data[12] & 0xFC) >> 2);
   
-  mss = new MultipleStringStructure(data + 13);
+  raw = data + 13;
+  rawLength = section_length + 3 - 13 - 4; // Minus header and CRC
+  
+  // The text is copied and decoded later without the section around it
+  if (!MultipleStringStructure::IsValid(raw, rawLength)) {
+    raw = NULL;
+    rawLength = 0;
+  }
 }
 
 
-//////////////////////////////////////////////////////////////////////////////
+//----------------------------------------------------------------------------
+
+const MultipleStringStructure* ETT::Text(void) const
+{
+  if (!mss && raw && rawLength > 0)
+    mss = new MultipleStringStructure(raw);
+    
+  return mss;
+}
 
 
+//////////////////////////////////////////////////////////////////////////////
@@ -39,11 +39,12 @@ public:
   virtual ~PSIPTable();
 
   virtual void Update(const u8* data, int length);
-  bool CheckCRC(void) { return crc_passed; }
+  bool CheckCRC(void) const { return crc_passed; }
   u8 Version(void) const { return version_number; }
   u8 TableID(void) const { return table_id; }
 
   static u8 ExtractVersion(const u8* data) { return (data[5] >> 1) & 0x1F; }
+  static bool IsValid(const u8* data, int length); // Length and CRC, without parsing
    
 protected:
   u8  table_id;
@@ -145,14 +146,35 @@ private:
 //////////////////////////////////////////////////////////////////////////////
 
 
+// Channel map of a VCT, parsed without building VDR channels
+class VCTChannelMap : public PSIPTable
+{
+public:
+  VCTChannelMap(const u8* data, int length);
+  
+  const ChannelMap& Map(void) const { return map; }
+  
+  static u16 ExtractTID(const u8* data) { return get_u16( data+3 ); }
+  
+private:
+  ChannelMap map;
+};
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
 class RRT : public PSIPTable
 {
 public:
   RRT(const u8* data, int length);
-  //virtual ~RRT() { }  
-
-private:
   
+  const RatingRegion& Region(void) const { return region; }
+  
+  static u8 ExtractRegion(const u8* data) { return data[4]; }
+  
+private:
+  RatingRegion region;
 };
 
 
@@ -168,15 +190,24 @@ public:
   u16 SourceID(void) const { return source_id; }
   u16 EventID(void)  const { return event_id; }
   
-  u8 NumberOfStrings(void) const { return mss ? mss->NumberOfStrings() : 0; }
-  std::string GetString(u32 i) const { return mss ? mss->GetString(i) : ""; }
+  u8 NumberOfStrings(void) const { return Text() ? Text()->NumberOfStrings() : 0; }
+  std::string GetString(u32 i) const { return Text() ? Text()->GetString(i) : ""; }
+  
+  // The undecoded multiple string structure, only valid as long as the 
+  // section data passed to the constructor.
+  const u8* RawText(void) const { return raw; }
+  int RawTextLength(void) const { return rawLength; }
   
   static u16 ExtractEventID(const u8* data) { 
     return (data[11] << 6) | ((data[12] & 0xFC) >> 2); 
   }
   
 private:
-  MultipleStringStructure* mss;
+  const MultipleStringStructure* Text(void) const;
+  
+  mutable MultipleStringStructure* mss; // Decoded on first use
+  const u8* raw;
+  int rawLength;
   
   u16 source_id;
   u16 event_id;
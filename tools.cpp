@@ -18,6 +18,8 @@
  */
 
 
+#include <vdr/thread.h>
+
 #include "tools.h"
 
 
@@ -72,3 +74,42 @@ void Utf16Converter::Convert(const char* in, size_t inSize, char* out, size_t ou
 //////////////////////////////////////////////////////////////////////////////
 
 
+int ChannelNumber(const char* numberCmd, uint16_t major, uint16_t minor)
+{
+  char* result = NULL;
+  char* cmd = NULL;
+  int num = 0;
+  
+  asprintf(&cmd, "%s %d %d", numberCmd, major, minor);
+  
+  cPipe p;
+  if (p.Open(cmd, "r"))
+  {
+    int l = 0;
+    int c;
+    while ((c = fgetc(p)) != EOF) {
+      if (l % 20 == 0)
+        result = (char*) realloc(result, l + 21);
+      result[l++] = c;
+    }
+    p.Close();
+    
+    if (result) {
+      result[l] = 0;
+      num = atoi(result);
+    }
+    else
+      num = 0;
+      
+    free(result);
+  }
+  else
+    dprint(L_ERR, "ERROR: can't open pipe for command '%s'", cmd);
+ 
+  free(cmd);
+  
+  return num;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
@@ -62,5 +62,13 @@ extern Utf16Converter Utf16;
 
 
 //////////////////////////////////////////////////////////////////////////////
-
+
+
+// Runs the "number" script for an ATSC channel. Returns the VDR channel 
+// number, 0 to leave it unnumbered or -1 to ignore the channel.
+int ChannelNumber(const char* numberCmd, uint16_t major, uint16_t minor);
+
+
+//////////////////////////////////////////////////////////////////////////////
+
 #endif //__ATSC_TOOLS_H
@@ -306,4 +306,63 @@ const char* GenreText(u8 type)
 }
 
 
+//----------------------------------------------------------------------------
+
+// ATSC genre codes 0x20 to 0xAD mapped to DVB content_nibble values
+// (ETSI EN 300 468 Table 28), 0x00 when there is no sensible equivalent.
+static const u8 genreContents[] = {
+/* 0x20 */ 0x90, 0x30, 0x10, 0x20, 0x73, 0x40, 0x00, 0x12, 
+/* 0x28 */ 0xA6, 0x55, 0x30, 0xA3, 0x32, 0x45, 0x45, 0x21, 
+/* 0x30 */ 0x82, 0x62, 0x90, 0x4B, 0x14, 0x24, 0x60, 0xA0, 
+/* 0x38 */ 0x61, 0x11, 0x66, 0x81, 0x10, 0x90, 0x18, 0xA4, 
+/* 0x40 */ 0x13, 0x91, 0x7B, 0x10, 0xA5, 0x45, 0x94, 0x80, 
+/* 0x48 */ 0x31, 0xA7, 0x40, 0x80, 0x93, 0x90, 0x95, 0xA0, 
+/* 0x50 */ 0x45, 0xA2, 0x13, 0x20, 0x96, 0x94, 0x24, 0x97, 
+/* 0x58 */ 0x80, 0xB3, 0x20, 0x92, 0x93, 0x80, 0x12, 0x10, 
+/* 0x60 */ 0x60, 0x11, 0x20, 0x91, 0x11, 0x80, 0x00, 0x00, 
+/* 0x68 */ 0xA6, 0x40, 0x80, 0x47, 0x75, 0xA2, 0x00, 0x7A, 
+/* 0x70 */ 0x16, 0x92, 0x10, 0x80, 0xA6, 0x15, 0x30, 0x11, 
+/* 0x78 */ 0x33, 0x92, 0x44, 0xA1, 0x32, 0x00, 0x21, 0x12, 
+/* 0x80 */ 0x72, 0x47, 0x92, 0x83, 0x48, 0x40, 0x4B, 0x55, 
+/* 0x88 */ 0x50, 0x17, 0x80, 0x92, 0x63, 0x80, 0x40, 0x50, 
+/* 0x90 */ 0x82, 0x46, 0x21, 0x4A, 0xA0, 0x10, 0x64, 0x81, 
+/* 0x98 */ 0x47, 0x70, 0x20, 0x20, 0x20, 0x20, 0x41, 0x00, 
+/* 0xA0 */ 0x71, 0x91, 0x61, 0x61, 0x13, 0x96, 0x14, 0x49, 
+/* 0xA8 */ 0x49, 0x43, 0x46, 0x81, 0x45, 0x4B
+};
+
+
+u8 GenreToContent(u8 type)
+{
+  if (type < 0x20 || type >= 0x20 + sizeof(genreContents))
+    return 0x00;
+    
+  return genreContents[type - 0x20];
+}
+
+
+//----------------------------------------------------------------------------
+
+// Minimum age for the rating values of region 1 (US), see CEA-766
+static const u8 tvRatingAge[]       = { 0, 0, 0, 10, 14, 17 };     // None, TV-G, TV-PG, TV-14, TV-MA
+static const u8 childrenRatingAge[] = { 0, 0, 7 };                 // TV-Y, TV-Y7
+static const u8 mpaaRatingAge[]     = { 0, 0, 0, 10, 13, 17, 18, 18, 0 }; // N/A, G, PG, PG-13, R, NC-17, X, NR
+
+
+int RatingToAge(u8 region, u8 dimension, u8 value)
+{
+  if (region != 1)
+    return 0;
+    
+  switch (dimension)
+  {
+    case 0: return (value < sizeof(tvRatingAge)) ? tvRatingAge[value] : 0;
+    case 5: return (value < sizeof(childrenRatingAge)) ? childrenRatingAge[value] : 0;
+    case 7: return (value < sizeof(mpaaRatingAge)) ? mpaaRatingAge[value] : 0;
+  }
+  
+  return 0;
+}
+
+
 //////////////////////////////////////////////////////////////////////////////
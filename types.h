@@ -40,6 +40,10 @@ const char* DescriptorText(u8 type);
 
 const char* GenreText(u8 type);
 
+u8 GenreToContent(u8 type);
+
+int RatingToAge(u8 region, u8 dimension, u8 value);
+
 
 // AC-3 Related
 const char* SampleRateText(u8 type);
@@ -18,9 +18,18 @@
  */
 
 #include <time.h>
+#include <limits.h>
 #include <string>
+#include <list>
+#include <vector>
+#include <algorithm>
 
 #include "vdrInterface.h"
+#include "config.h"
+#include "stats.h"
+#include "descriptionStore.h"
+#include "guideStore.h"
+#include "types.h"
 
 
 //////////////////////////////////////////////////////////////////////////////
@@ -28,44 +37,107 @@
 
 bool VDRInterface::AddEvents(cChannel* channel, const EIT& eit)
 {
-  if (!channel)
+  return AddEvents(channel, eit.GetEvent(0), eit.NumberOfEvents());
+}
+
+
+//----------------------------------------------------------------------------
+
+bool VDRInterface::AddEvents(cChannel* channel, const Event* events, int numEvents)
+{
+  if (!channel || !events)
+    return false;
+
+#ifdef USE_EPG_HANDLERS
+  bool handlers = UseEpgHandlers();
+  if (handlers && (EpgHandlers.IgnoreChannel(channel) || EpgHandlers.HandledExternally(channel))) {
+    dprint(L_VDR, "EPG handlers: ignoring events for %s", *channel->GetChannelID().ToString());
     return false;
+  }
+  
+  std::vector<cEvent*> batch;
+  time_t segmentStart = 0;
+  time_t segmentEnd = 0;
+#endif
 
   bool modified = false;
+  time_t horizon = time(NULL) + config.epgHorizon * SECSINDAY;
     
-  cSchedulesLock SchedulesLock;
+  cSchedulesLock SchedulesLock(true);
   const cSchedules* Schedules = cSchedules::Schedules(SchedulesLock);
+  if (!Schedules)
+    return false;
   
   cSchedule* s = (cSchedule*) Schedules->GetSchedule(channel, true);
 
-  for (u32 i=0; i<eit.NumberOfEvents(); i++)
+  for (int i=0; i<numEvents; i++)
   {
-    const Event* e = eit.GetEvent(i);
+    const Event* e = &events[i];
+    time_t startTime = GPStoLocal(e->start_time);
+    
+    if (startTime > horizon) {
+      Stats.Add(S_EVENTS_HORIZON);
+      continue;
+    }
 
     // Check if event already exit
-    cEvent* pEvent = (cEvent*) s->GetEvent(e->event_id, GPStoLocal(e->start_time));
+    cEvent* pEvent = (cEvent*) s->GetEvent(e->event_id, startTime);
     if (!pEvent) {
-      dprint(L_VDR, "New event: id %d (sid: %d, tid: %d, ver: %d)", e->event_id, eit.SourceID() , eit.TableID(), e->version_number);
-      s->AddEvent( CreateVDREvent(e) );
+      dprint(L_VDR, "New event: id %d (sid: %d, tid: %d, ver: %d)", e->event_id, channel->Sid(), e->table_id, e->version_number);
+      pEvent = s->AddEvent( CreateVDREvent(e) );
       modified = true;
+      Stats.Add(S_EVENTS_ADDED);
     } 
     else {
-      dprint(L_VDR, "Old event: id %d (sid: %d, tid: %d, ver: %d)", e->event_id, eit.SourceID() , eit.TableID(), e->version_number);
+      dprint(L_VDR, "Old event: id %d (sid: %d, tid: %d, ver: %d)", e->event_id, channel->Sid(), e->table_id, e->version_number);
       dprint(L_VDR, "      was: id %d (sid: ?, tid: %d, ver: %d)", pEvent->EventID(), pEvent->TableID(), pEvent->Version());
         
       pEvent->SetEventID(e->event_id);
       pEvent->SetSeen();
         
-      if (pEvent->Version() != e->version_number) {
+      bool update = pEvent->Version() != e->version_number;
+#ifdef USE_EPG_HANDLERS
+      if (handlers && !update)
+        update = EpgHandlers.IsUpdate(e->event_id, startTime, e->table_id, e->version_number);
+#endif
+      if (update) {
         dprint(L_VDR, "           new version!");
         ToVDREvent(e, pEvent);
         modified = true;  
+        Stats.Add(S_EVENTS_UPDATED);
       }
+      else
+        continue;
     }
+    
+#ifdef USE_EPG_HANDLERS
+    if (handlers) 
+    {
+      batch.push_back(pEvent);
+      if (!segmentStart || pEvent->StartTime() < segmentStart)
+        segmentStart = pEvent->StartTime();
+      if (pEvent->EndTime() > segmentEnd)
+        segmentEnd = pEvent->EndTime();
+    }
+#endif
   }
     
   if (modified) 
   {
+#ifdef USE_EPG_HANDLERS
+    if (handlers)
+    {
+      // Run the handler chain once for the whole table
+      for (unsigned int i=0; i<batch.size(); i++) {
+        EpgHandlers.FixEpgBugs(batch[i]);
+        EpgHandlers.HandleEvent(batch[i]);
+      }
+      EpgHandlers.SortSchedule(s);
+      EpgHandlers.DropOutdated(s, segmentStart, segmentEnd, events[0].table_id, events[0].version_number);
+      dprint(L_VDR, "EPG handlers: processed %d events", (int) batch.size());
+    }
+    else
+#endif
     s->Sort();
     Schedules->SetModified(s);  
   } 
@@ -78,27 +150,47 @@ bool VDRInterface::AddEvents(cChannel* channel, const EIT& eit)
 
 bool VDRInterface::AddDescription(cChannel* channel, const ETT& ett)
 {
-  if (!channel)
+  return AddDescription(channel, ett.EventID(), ett.RawText(), ett.RawTextLength());
+}
+
+
+//----------------------------------------------------------------------------
+
+bool VDRInterface::AddDescription(cChannel* channel, uint16_t eid, const u8* text, int length)
+{
+  if (!channel || !MultipleStringStructure::IsValid(text, length))
     return false;
 
-  //TODO: Other languages...
-  std::string desc = ett.GetString(0);
-  //std::string desc = "";
-  //for (u32 i=0; i<ett.getNumStrings(); i++)
-  //  desc += ett.getString(i);
-  
-  uint16_t eid = ett.EventID();
   if (eid) // Event ETM
   {
-    cSchedulesLock SchedulesLock;
+#ifdef USE_EPG_HANDLERS
+    if (UseEpgHandlers() && (EpgHandlers.IgnoreChannel(channel) || EpgHandlers.HandledExternally(channel)))
+      return false;
+#endif
+
+    cSchedulesLock SchedulesLock(true);
     const cSchedules* Schedules = cSchedules::Schedules(SchedulesLock);
+    if (!Schedules)
+      return false;
     cSchedule* s = (cSchedule*) Schedules->GetSchedule(channel, true);
       
     cEvent* event = (cEvent*) s->GetEvent(eid);
-    if (event)         
-      event->SetDescription( desc.c_str() );
-    else
+    if (!event)
       return false;
+      
+    // Events far in the future keep their text compressed until needed
+    if (config.descriptionWindow && event->StartTime() > time(NULL) + config.descriptionWindow * 3600)
+    {
+      DescriptionStore.Put(channel->GetChannelID(), eid, event->StartTime(), text, length);
+      Stats.Add(S_DESCRIPTIONS_DEFERRED);
+      return true;
+    }
+    
+    std::string desc = MultipleStringStructure::FirstString(text, length);
+      
+    SetDescription(event, desc.c_str());
+    Schedules->SetModified(s);
+    Stats.Add(S_DESCRIPTIONS_ADDED);
   }
   else // Channel ETM
     dprint(L_DBG, "Got Channel ETM, ignored.");
@@ -107,6 +199,191 @@ bool VDRInterface::AddDescription(cChannel* channel, const ETT& ett)
 }
 
 
+//----------------------------------------------------------------------------
+
+void VDRInterface::PublishDescriptions(void)
+{
+  time_t due = config.descriptionWindow ? time(NULL) + config.descriptionWindow * 3600 : LONG_MAX;
+  
+  std::list<cDescriptionStore::Description> descriptions;
+  DescriptionStore.TakeDue(due, descriptions);
+  if (descriptions.empty())
+    return;
+    
+  cSchedulesLock SchedulesLock(true);
+  const cSchedules* Schedules = cSchedules::Schedules(SchedulesLock);
+  if (!Schedules)
+    return;
+  
+  int n = 0;
+  std::list<cDescriptionStore::Description>::const_iterator itr;
+  for (itr = descriptions.begin(); itr != descriptions.end(); itr++)
+  {
+    cSchedule* s = (cSchedule*) Schedules->GetSchedule(itr->channelID);
+    cEvent* event = s ? (cEvent*) s->GetEvent(itr->eventId) : NULL;
+    if (event) {
+      SetDescription(event, itr->text.c_str());
+      Schedules->SetModified(s);
+      n++;
+    }
+  }
+  
+  Stats.Add(S_DESCRIPTIONS_ADDED, n);
+  dprint(L_VDR, "Published %d deferred descriptions", n);
+}
+
+
+//----------------------------------------------------------------------------
+
+bool VDRInterface::GetDescription(const tChannelID& channelID, tEventID eventID, cString& description)
+{
+  std::string text;
+  if (DescriptionStore.Get(channelID, eventID, text)) {
+    description = text.c_str();
+    return true;
+  }
+  
+  if (GuideStore.GetDescription(channelID, eventID, text)) {
+    description = text.c_str();
+    return true;
+  }
+  
+  // Not in the guide (yet), VDR may have it
+  cSchedulesLock SchedulesLock;
+  const cSchedules* Schedules = cSchedules::Schedules(SchedulesLock);
+  const cSchedule* s = Schedules ? Schedules->GetSchedule(channelID) : NULL;
+  const cEvent* event = s ? s->GetEvent(eventID) : NULL;
+  if (!event || !event->Description())
+    return false;
+    
+  description = event->Description();
+  return true;
+}
+
+
+//----------------------------------------------------------------------------
+
+struct EventSize {
+  time_t start;
+  int bytes;
+  bool operator< (const EventSize& arg) const { return start > arg.start; } // Furthest-out first
+};
+
+
+void VDRInterface::EnforceBudget(void)
+{
+  cSchedulesLock SchedulesLock(true, 1000);
+  const cSchedules* Schedules = cSchedules::Schedules(SchedulesLock);
+  if (!Schedules)
+    return;
+  
+  long long budget = MEGABYTE(config.epgBudget);
+  long long bytes = 0;
+  int count = 0;
+  
+  for (cSchedule* s = Schedules->First(); s; s = Schedules->Next(s))
+  {
+    if (s->ChannelID().Source() != cSource::stAtsc)
+      continue;
+    for (const cEvent* e = s->Events()->First(); e; e = s->Events()->Next(e)) {
+      bytes += EventBytes(e);
+      count++;
+    }
+  }
+  
+  if (budget && bytes > budget)
+  {
+    dprint(L_VDR, "EPG uses %lld bytes, budget is %lld bytes: pruning", bytes, budget);
+    time_t now = time(NULL);
+    long long freed = 0;
+    int pruned = 0;
+    std::vector<EventSize> future;
+    
+    // Drop events that have already ended first, remember the others
+    for (cSchedule* s = Schedules->First(); s; s = Schedules->Next(s))
+    {
+      if (s->ChannelID().Source() != cSource::stAtsc)
+        continue;
+      bool modified = false;
+      const cEvent* next;
+      for (const cEvent* e = s->Events()->First(); e; e = next) 
+      {
+        next = s->Events()->Next(e);
+        if (e->HasTimer())
+          continue;
+        int size = EventBytes(e);
+        if (e->EndTime() < now && bytes - freed > budget) {
+          s->DelEvent((cEvent*) e);
+          freed += size;
+          pruned++;
+          modified = true;
+        }
+        else {
+          EventSize es = { e->StartTime(), size };
+          future.push_back(es);
+        }
+      }
+      if (modified)
+        Schedules->SetModified(s);
+    }
+    
+    // Then drop the furthest-out events until we are within the budget
+    if (bytes - freed > budget && !future.empty())
+    {
+      std::sort(future.begin(), future.end());
+      time_t cutoff = 0;
+      long long excess = bytes - freed - budget;
+      for (unsigned int i=0; i<future.size() && excess > 0; i++) {
+        cutoff = future[i].start;
+        excess -= future[i].bytes;
+      }
+      
+      for (cSchedule* s = Schedules->First(); s; s = Schedules->Next(s))
+      {
+        if (s->ChannelID().Source() != cSource::stAtsc)
+          continue;
+        bool modified = false;
+        const cEvent* next;
+        for (const cEvent* e = s->Events()->First(); e; e = next) 
+        {
+          next = s->Events()->Next(e);
+          if (e->StartTime() >= cutoff && !e->HasTimer()) {
+            freed += EventBytes(e);
+            pruned++;
+            s->DelEvent((cEvent*) e);
+            modified = true;
+          }
+        }
+        if (modified)
+          Schedules->SetModified(s);
+      }
+    }
+    
+    dprint(L_VDR, "Pruned %d events (%lld bytes)", pruned, freed);
+    Stats.Add(S_EVENTS_PRUNED, pruned);
+    Stats.Add(S_BYTES_PRUNED, freed);
+    bytes -= freed;
+    count -= pruned;
+  }
+  
+  Stats.Set(S_EPG_EVENTS, count);
+  Stats.Set(S_EPG_BYTES, bytes);
+  Stats.Set(S_EPG_BUDGET, budget);
+}
+
+
+//----------------------------------------------------------------------------
+
+int VDRInterface::EventBytes(const cEvent* event)
+{
+  int size = sizeof(cEvent);
+  if (event->Title())       size += strlen(event->Title()) + 1;
+  if (event->ShortText())   size += strlen(event->ShortText()) + 1;
+  if (event->Description()) size += strlen(event->Description()) + 1;
+  return size;
+}
+
+
 //----------------------------------------------------------------------------
 
 static time_t UtcOffset(void)
@@ -145,6 +422,13 @@ void VDRInterface::ToVDREvent(const Event* event, cEvent* vdrEvent)
 {
   if (!event || !vdrEvent) return;
   
+#ifdef USE_EPG_HANDLERS
+  if (UseEpgHandlers()) {
+    ToVDREventHandlers(event, vdrEvent);
+    return;
+  }
+#endif
+  
   vdrEvent->SetEventID(event->event_id);
   vdrEvent->SetStartTime( GPStoLocal(event->start_time) );
   vdrEvent->SetDuration(event->length_in_seconds);
@@ -152,9 +436,90 @@ void VDRInterface::ToVDREvent(const Event* event, cEvent* vdrEvent)
   vdrEvent->SetVersion(event->version_number);
   vdrEvent->SetTableID(event->table_id);
   
+  uchar contents[MaxEventContents] = { 0 };
+  GetContents(event->attributes, contents);
+  vdrEvent->SetContents(contents);
+  vdrEvent->SetParentalRating( GetParentalRating(event->attributes) );
+  
   if (event->ETM_location == 0x00) // There is no description for this event
     vdrEvent->SetDescription("No description provided for this event.");
 }
 
 
+//----------------------------------------------------------------------------
+
+void VDRInterface::GetContents(const EventAttributes& attributes, uchar* contents)
+{
+  int n = 0;
+  for (int i=0; i<attributes.numGenres && n<MaxEventContents; i++)
+  {
+    uchar c = GenreToContent(attributes.genre[i]);
+    bool duplicate = false;
+    for (int j=0; j<n; j++)
+      if (contents[j] == c)
+        duplicate = true;
+    if (c && !duplicate)
+      contents[n++] = c;
+  }
+}
+
+
+//----------------------------------------------------------------------------
+
+int VDRInterface::GetParentalRating(const EventAttributes& attributes)
+{
+  int age = 0;
+  for (u8 i=0; i<8; i++)
+    age = max(age, RatingToAge(attributes.ratingRegion, i, attributes.Rating(i)));
+    
+  return age;
+}
+
+
+//----------------------------------------------------------------------------
+
+void VDRInterface::SetDescription(cEvent* event, const char* description)
+{
+#ifdef USE_EPG_HANDLERS
+  if (UseEpgHandlers()) {
+    EpgHandlers.SetDescription(event, description);
+    EpgHandlers.HandleEvent(event);
+    return;
+  }
+#endif
+  event->SetDescription(description);
+}
+
+
+#ifdef USE_EPG_HANDLERS
+//----------------------------------------------------------------------------
+
+bool VDRInterface::UseEpgHandlers(void)
+{
+  return config.useEpgHandlers && EpgHandlers.Count() > 0;
+}
+
+
+//----------------------------------------------------------------------------
+
+void VDRInterface::ToVDREventHandlers(const Event* event, cEvent* vdrEvent)
+{
+  EpgHandlers.SetEventID(vdrEvent, event->event_id);
+  EpgHandlers.SetStartTime(vdrEvent, GPStoLocal(event->start_time));
+  EpgHandlers.SetDuration(vdrEvent, event->length_in_seconds);
+  EpgHandlers.SetTitle(vdrEvent, event->TitleText());
+  vdrEvent->SetVersion(event->version_number);
+  vdrEvent->SetTableID(event->table_id);
+  
+  uchar contents[MaxEventContents] = { 0 };
+  GetContents(event->attributes, contents);
+  EpgHandlers.SetContents(vdrEvent, contents);
+  EpgHandlers.SetParentalRating(vdrEvent, GetParentalRating(event->attributes));
+  
+  if (event->ETM_location == 0x00) // There is no description for this event
+    EpgHandlers.SetDescription(vdrEvent, "No description provided for this event.");
+}
+#endif
+
+
 //////////////////////////////////////////////////////////////////////////////
@@ -28,6 +28,13 @@
 #include "structs.h"
 
 
+// VDR 1.7.27 added the hooks we need to pass events through the EPG
+// handlers of other plugins.
+#if VDRVERSNUM >= 10727
+#define USE_EPG_HANDLERS
+#endif
+
+
 //////////////////////////////////////////////////////////////////////////////
 
 
@@ -35,12 +42,26 @@ class VDRInterface
 {
 public:
   static bool AddEvents(cChannel* channel, const EIT& eit);
+  static bool AddEvents(cChannel* channel, const Event* events, int numEvents);
   static bool AddDescription(cChannel* channel, const ETT& ett);
+  static bool AddDescription(cChannel* channel, uint16_t eventId, const u8* text, int length);
+  static void EnforceBudget(void);
+  static void PublishDescriptions(void);
+  static bool GetDescription(const tChannelID& channelID, tEventID eventID, cString& description);
+  static time_t GPStoLocal(time_t gps); 
 
 private:
   static void ToVDREvent(const Event* event, cEvent* vdrEvent);
   static cEvent* CreateVDREvent(const Event* event);
-  static time_t GPStoLocal(time_t gps); 
+  static int EventBytes(const cEvent* event);
+  static void GetContents(const EventAttributes& attributes, uchar* contents);
+  static int GetParentalRating(const EventAttributes& attributes);
+  static void SetDescription(cEvent* event, const char* description);
+  
+#ifdef USE_EPG_HANDLERS
+  static bool UseEpgHandlers(void);
+  static void ToVDREventHandlers(const Event* event, cEvent* vdrEvent);
+#endif
 };
 
 
@@ -0,0 +1,499 @@
+/*
+ * Copyright (C) 2006-2010 Alex Lasnier <alex@fepg.org>
+ *
+ * This file is part of ATSC EPG
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdarg.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <map>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include <vdr/channels.h>
+#include <vdr/sources.h>
+
+#include "xmltvExport.h"
+#include "guideStore.h"
+#include "filterManager.h"
+#include "vdrInterface.h"
+#include "descriptors.h"
+#include "types.h"
+#include "ratingTables.h"
+
+#define CHANNELS_LOCK_TIMEOUT 1000 // ms
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+cXmltvExport XmltvExport;
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+cBufferedWriter::cBufferedWriter(void)
+{
+  fd = -1;
+  failed = false;
+  used = 0;
+}
+
+
+//----------------------------------------------------------------------------
+
+cBufferedWriter::~cBufferedWriter()
+{
+  Close();
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cBufferedWriter::Open(const char* FileName)
+{
+  Close();
+  
+  fd = open(FileName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  failed = (fd < 0);
+  used = 0;
+  
+  if (failed)
+    dprint(L_ERR, "XMLTV: cannot create %s.", FileName);
+  return !failed;
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cBufferedWriter::Close(void)
+{
+  if (fd < 0)
+    return false;
+    
+  Flush();
+  if (close(fd) < 0)
+    failed = true;
+  fd = -1;
+  
+  return !failed;
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cBufferedWriter::Flush(void)
+{
+  const char* p = buffer;
+  while (used > 0 && !failed) 
+  {
+    ssize_t n = write(fd, p, used);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      dprint(L_ERR, "XMLTV: write failed (%s).", strerror(errno));
+      failed = true;
+      break;
+    }
+    p += n;
+    used -= n;
+  }
+  
+  used = 0;
+  return !failed;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cBufferedWriter::Write(const char* data, size_t length)
+{
+  while (length > 0)
+  {
+    if (used == sizeof(buffer))
+      Flush();
+      
+    size_t n = std::min(length, sizeof(buffer) - used);
+    memcpy(buffer + used, data, n);
+    used += n;
+    data += n;
+    length -= n;
+  }
+}
+
+
+//----------------------------------------------------------------------------
+
+void cBufferedWriter::Printf(const char* fmt, ...)
+{
+  char line[1024];
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vsnprintf(line, sizeof(line), fmt, ap);
+  va_end(ap);
+  
+  if (n > 0)
+    Write(line, std::min((size_t) n, sizeof(line) - 1));
+}
+
+
+//----------------------------------------------------------------------------
+
+void cBufferedWriter::WriteEscaped(const char* s, size_t length)
+{
+  size_t start = 0;
+  for (size_t i=0; i<length; i++)
+  {
+    const char* entity;
+    switch (s[i]) {
+      case '&':  entity = "&amp;";  break;
+      case '<':  entity = "&lt;";   break;
+      case '>':  entity = "&gt;";   break;
+      case '"':  entity = "&quot;"; break;
+      default:
+        // Control characters are not allowed in XML
+        if ((uint8_t) s[i] < 0x20 && s[i] != '\n' && s[i] != '\t')
+          entity = " ";
+        else
+          continue;
+    }
+    Write(s + start, i - start);
+    Write(entity);
+    start = i + 1;
+  }
+  Write(s + start, length - start);
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cBufferedWriter::Copy(const char* FileName)
+{
+  int in = open(FileName, O_RDONLY);
+  if (in < 0)
+    return false;
+    
+  for (;;) 
+  {
+    if (used == sizeof(buffer))
+      Flush();
+      
+    ssize_t n = read(in, buffer + used, sizeof(buffer) - used);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    used += n;
+  }
+  
+  close(in);
+  return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+cXmltvExport::cXmltvExport(void) : cThread("ATSC XMLTV export", true)
+{
+  exportAll = true;
+}
+
+
+//----------------------------------------------------------------------------
+
+cXmltvExport::~cXmltvExport()
+{
+  Close();
+}
+
+
+//----------------------------------------------------------------------------
+
+void cXmltvExport::SetFileName(const char* FileName)
+{
+  fileName = FileName;
+}
+
+
+//----------------------------------------------------------------------------
+
+void cXmltvExport::Open(const char* PartsDirectory)
+{
+  partsDirectory = PartsDirectory;
+  MakeDirs(partsDirectory, true);
+  
+  if (Enabled())
+    Start();
+}
+
+
+//----------------------------------------------------------------------------
+
+void cXmltvExport::Close(void)
+{
+  if (Active()) {
+    Cancel(-1);
+    wait.Signal();
+    Cancel(3);
+  }
+}
+
+
+//----------------------------------------------------------------------------
+
+void cXmltvExport::Trigger(int transponder)
+{
+  if (!Enabled())
+    return;
+    
+  cMutexLock lock(&mutex);
+  pending.insert(transponder);
+  wait.Signal();
+}
+
+
+//----------------------------------------------------------------------------
+
+void cXmltvExport::Action(void)
+{
+  while (Running())
+  {
+    std::set<int> transponders;
+    bool all;
+    {
+      cMutexLock lock(&mutex);
+      transponders.swap(pending);
+      all = exportAll;
+      exportAll = false;
+    }
+    
+    int numChannels = 0, numProgrammes = 0;
+    if (all)
+      Export(fileName, numChannels, numProgrammes);
+    else if (!transponders.empty()) 
+    {
+      cMutexLock lock(&exportMutex);
+      for (std::set<int>::iterator i = transponders.begin(); i != transponders.end(); i++)
+        WriteParts(*i, numChannels, numProgrammes);
+      Assemble(fileName);
+    }
+    
+    wait.Wait(0);
+  }
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cXmltvExport::Export(const char* FileName, int& numChannels, int& numProgrammes)
+{
+  cMutexLock lock(&exportMutex);
+  cTimeMs timer;
+  
+  numChannels = 0;
+  numProgrammes = 0;
+  
+  std::vector<int> transponders;
+  FilterManager.GetTransponders(transponders);
+  for (unsigned int i=0; i<transponders.size(); i++)
+    WriteParts(transponders[i], numChannels, numProgrammes);
+    
+  if (!Assemble(FileName))
+    return false;
+    
+  dprint(L_MSG, "XMLTV: wrote %s, %d channel(s) and %d programme(s) in %d ms.", FileName, numChannels, numProgrammes, (int) timer.Elapsed());
+  return true;
+}
+
+
+//----------------------------------------------------------------------------
+
+cString cXmltvExport::PartName(int transponder, const char* kind) const
+{
+  return cString::sprintf("%s/%d.%s", *partsDirectory, transponder, kind);
+}
+
+
+//----------------------------------------------------------------------------
+
+static void FormatTime(char* buffer, size_t size, time_t t)
+{
+  struct tm tm_r;
+  strftime(buffer, size, "%Y%m%d%H%M%S %z", localtime_r(&t, &tm_r));
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cXmltvExport::WriteParts(int transponder, int& numChannels, int& numProgrammes)
+{
+  ChannelMap channelMap;
+  if (!FilterManager.GetLastChannelMap(transponder, channelMap))
+    return false;
+    
+  // The names are copied so the channels are not locked while writing
+  std::vector<std::string> names(channelMap.channels.size());
+  if (!Channels.Lock(false, CHANNELS_LOCK_TIMEOUT))
+    return false;
+  for (unsigned int i=0; i<channelMap.channels.size(); i++)
+  {
+    const ChannelMap::Entry& e = channelMap.channels[i];
+    cChannel* channel = Channels.GetByChannelID(tChannelID(cSource::stAtsc, 0, channelMap.tsid, e.programNumber), true);
+    if (channel)
+      names[i] = channel->Name();
+  }
+  Channels.Unlock();
+  
+  // Channels
+  std::map<uint16_t, cString> ids; // By source id
+  cBufferedWriter out;
+  if (!out.Open(PartName(transponder, "channels")))
+    return false;
+    
+  for (unsigned int i=0; i<channelMap.channels.size(); i++)
+  {
+    const ChannelMap::Entry& e = channelMap.channels[i];
+    cString id = cString::sprintf("%d.%d.%d.atsc", e.majorNumber, e.minorNumber, channelMap.tsid);
+    ids[e.sourceId] = id;
+    
+    out.Printf("  <channel id=\"%s\">\n", *id);
+    if (!names[i].empty()) {
+      out.Write("    <display-name>");
+      out.WriteEscaped(names[i].c_str(), names[i].size());
+      out.Write("</display-name>\n");
+    }
+    out.Printf("    <display-name>%d.%d</display-name>\n", e.majorNumber, e.minorNumber);
+    out.Write("  </channel>\n");
+    numChannels++;
+  }
+  
+  if (!out.Close())
+    return false;
+    
+  // Programmes, only this transponder is held in memory
+  std::vector<cGuideStore::Entry> entries;
+  GuideStore.GetEvents(transponder, entries);
+  
+  if (!out.Open(PartName(transponder, "programmes")))
+    return false;
+    
+  for (unsigned int i=0; i<entries.size(); i++)
+  {
+    const cGuideStore::Entry& e = entries[i];
+    std::map<uint16_t, cString>::const_iterator id = ids.find(e.sourceId);
+    if (id == ids.end())
+      continue;
+      
+    char start[32], stop[32];
+    time_t startTime = VDRInterface::GPStoLocal(e.event.start_time);
+    FormatTime(start, sizeof(start), startTime);
+    FormatTime(stop, sizeof(stop), startTime + e.event.length_in_seconds);
+    out.Printf("  <programme start=\"%s\" stop=\"%s\" channel=\"%s\">\n", start, stop, *id->second);
+    
+    const char* title = e.event.TitleText() ? e.event.TitleText() : "";
+    out.Write("    <title>");
+    out.WriteEscaped(title, strlen(title));
+    out.Write("</title>\n");
+    
+    if (!e.text.empty()) 
+    {
+      std::string desc = MultipleStringStructure::FirstString((const u8*) e.text.data(), e.text.size());
+      if (!desc.empty()) {
+        out.Write("    <desc>");
+        out.WriteEscaped(desc.data(), desc.size());
+        out.Write("</desc>\n");
+      }
+    }
+    
+    const EventAttributes& a = e.event.attributes;
+    for (int k=0; k<a.numGenres; k++)
+    {
+      if (a.genre[k] < 0x20 || a.genre[k] > 0xAD)
+        continue;
+      const char* genre = GenreText(a.genre[k]);
+      size_t length = strlen(genre);
+      while (length > 0 && genre[length-1] == ' ')
+        length--;
+      out.Write("    <category>");
+      out.WriteEscaped(genre, length);
+      out.Write("</category>\n");
+    }
+    
+    if (a.wideAspect)
+      out.Write("    <video>\n      <aspect>16:9</aspect>\n    </video>\n");
+    if (a.surround)
+      out.Write("    <audio>\n      <stereo>surround</stereo>\n    </audio>\n");
+    
+    std::string system, rating;
+    if (RatingTables.GetRating(a, system, rating)) {
+      out.Write("    <rating system=\"");
+      out.WriteEscaped(system.data(), system.size());
+      out.Write("\">\n      <value>");
+      out.WriteEscaped(rating.data(), rating.size());
+      out.Write("</value>\n    </rating>\n");
+    }
+    
+    out.Write("  </programme>\n");
+    numProgrammes++;
+  }
+  
+  if (!out.Close())
+    return false;
+    
+  parts.insert(transponder);
+  return true;
+}
+
+
+//----------------------------------------------------------------------------
+
+bool cXmltvExport::Assemble(const char* FileName)
+{
+  cString tmpName = cString::sprintf("%s.tmp", FileName);
+  const char* charset = cCharSetConv::SystemCharacterTable() ? cCharSetConv::SystemCharacterTable() : "UTF-8";
+  
+  cBufferedWriter out;
+  if (!out.Open(tmpName))
+    return false;
+    
+  out.Printf("<?xml version=\"1.0\" encoding=\"%s\"?>\n", charset);
+  out.Write("<!DOCTYPE tv SYSTEM \"xmltv.dtd\">\n");
+  out.Write("<tv generator-info-name=\"vdr-atscepg\">\n");
+  
+  // All channels must come before the programmes
+  for (std::set<int>::iterator i = parts.begin(); i != parts.end(); i++)
+    out.Copy(PartName(*i, "channels"));
+  for (std::set<int>::iterator i = parts.begin(); i != parts.end(); i++)
+    out.Copy(PartName(*i, "programmes"));
+    
+  out.Write("</tv>\n");
+  
+  if (!out.Close() || rename(tmpName, FileName) != 0) {
+    dprint(L_ERR, "XMLTV: cannot write %s.", FileName);
+    unlink(tmpName);
+    return false;
+  }
+  
+  return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2006-2010 Alex Lasnier <alex@fepg.org>
+ *
+ * This file is part of ATSC EPG
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __ATSC_XMLTV_EXPORT_H
+#define __ATSC_XMLTV_EXPORT_H
+
+#include <string.h>
+#include <set>
+
+#include <vdr/thread.h>
+#include <vdr/tools.h>
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+// Writes files through a fixed size buffer
+class cBufferedWriter
+{
+public:
+  cBufferedWriter(void);
+  ~cBufferedWriter();
+  
+  bool Open(const char* FileName);
+  bool Close(void);
+  
+  void Write(const char* data, size_t length);
+  void Write(const char* s) { Write(s, strlen(s)); }
+  void Printf(const char* fmt, ...) __attribute__ ((format (printf, 2, 3)));
+  void WriteEscaped(const char* s, size_t length);
+  bool Copy(const char* FileName);
+  
+private:
+  bool Flush(void);
+  
+  int fd;
+  bool failed;
+  size_t used;
+  char buffer[64 * 1024];
+};
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+// Exports the guide store as XMLTV. The channels and programmes of each 
+// transponder are written to separate parts, which are then concatenated 
+// into the XMLTV file, so an acquisition only rewrites its own transponder.
+class cXmltvExport : public cThread
+{
+public:
+  cXmltvExport(void);
+  virtual ~cXmltvExport();
+  
+  void SetFileName(const char* FileName);
+  bool Enabled(void) const { return *fileName != NULL; }
+  cString FileName(void) const { return fileName; }
+  void Open(const char* PartsDirectory);
+  void Close(void);
+  
+  void Trigger(int transponder);
+  bool Export(const char* FileName, int& numChannels, int& numProgrammes);
+  
+protected:
+  virtual void Action(void);
+  
+private:
+  bool WriteParts(int transponder, int& numChannels, int& numProgrammes);
+  bool Assemble(const char* FileName);
+  cString PartName(int transponder, const char* kind) const;
+  
+  cString fileName;
+  cString partsDirectory;
+  std::set<int> parts;   // Transponders with parts written
+  std::set<int> pending; // Protected by mutex
+  bool exportAll;
+  cMutex mutex;
+  cMutex exportMutex;    // Serializes writing the parts and the file
+  cCondWait wait;
+};
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+extern cXmltvExport XmltvExport;
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+
+#endif //__ATSC_XMLTV_EXPORT_H